@@ -1,5 +1,6 @@
 import msgpack from 'msgpack-lite';
 import { SET_VALUE, SYNC_VALUE } from '../constants/ActionTypes'
+import { dropStaleImageFrames, resolveImageFrames } from '../store/image-frames'
 
 export function setValue( ws, obj ) {
     return ( dispatch ) => {
@@ -13,8 +14,11 @@ export function syncValue( res ) {
     {
         res = [res];
     }
-    res.forEach( ( { id, type, label, value, param, version } ) => {
-        payload[id] = { type, label, value, param, version }
+    res.forEach( ( { id, ...fields } ) => {
+        dropStaleImageFrames( id, fields.removed ? Infinity : fields.version );
+        resolveImageFrames( id, fields.version, fields.value );
+        resolveImageFrames( id, fields.version, fields.value_patch );
+        payload[id] = fields;
     })
 
     return {
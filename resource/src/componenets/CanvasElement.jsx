@@ -1,20 +1,27 @@
 import React from 'react';
-import {Buffer} from 'buffer';
-import LZ4 from 'lz4';
 import Konva  from 'konva';
 import ElementComponent from './ElementComponent';
+import { decodeImageFrame, requestImageFrame } from '../store/image-frames';
 
 const MAX_SCALE = 15.0;
 const UNIT_SCALE_DIST = 120;
 const UNIT_WINDOW_DIST = 400;
 
+// Image commands left untouched by a delta update keep their objects, so their decoded pixels are reused.
+const decoded_images = new WeakMap();
+// Decoded tiles kept per tiled image. Beyond that, the least recently shown ones out of view are dropped.
+const MAX_CACHED_TILES = 256;
+
 function convertArrayView( view, format ) {
     switch( format ) {
         case SdvizImage.RGB_888:
+        case SdvizImage.RGBA_8888:
         case SdvizImage.UINT_8:
             return new Uint8Array( view.buffer );
         case SdvizImage.UINT_16:
             return new Uint16Array( view.buffer );
+        case SdvizImage.INT_16:
+            return new Int16Array( view.buffer );
     }
 
     throw new Error( "Unknown image format." );
@@ -24,8 +31,11 @@ function getChannelsPerPixel( format ) {
     switch( format ) {
         case SdvizImage.RGB_888:
             return 3;
+        case SdvizImage.RGBA_8888:
+            return 4;
         case SdvizImage.UINT_8:
         case SdvizImage.UINT_16:
+        case SdvizImage.INT_16:
             return 1;
     }
 
@@ -35,26 +45,37 @@ function getChannelsPerPixel( format ) {
 function getBytesPerChannel( format ) {
     switch( format ) {
         case SdvizImage.RGB_888:
+        case SdvizImage.RGBA_8888:
         case SdvizImage.UINT_8:
             return 1;
         case SdvizImage.UINT_16:
+        case SdvizImage.INT_16:
             return 2;
     }
 
     throw new Error( "Unknown image format." );
 }
 
+// Decodes straight into a fresh typed array, so the pixels are never copied afterwards.
 function uncompressLZ4( buffer, uncompressSize, format ) {
-    const uncompBuffer = new Buffer( uncompressSize );
-    const uncompBufferSize = LZ4.decodeBlock( buffer, uncompBuffer );
+    const view = new Uint8Array( uncompressSize );
+    decodeImageFrame( buffer, view );
+    return convertArrayView( view, format );
+}
 
-    const ab = new ArrayBuffer(uncompBufferSize);
-    const view = new Uint8Array( ab );
-    for( let i = 0;i < uncompBufferSize; ++i )
-    {
-        view[i] = uncompBuffer[i];
+// Decodes a frame of src_image, which may be a level of its pyramid and so smaller than the image.
+function decodeImage( src_image, frame ) {
+    const image_size = getChannelsPerPixel( src_image.format ) * getBytesPerChannel( src_image.format ) * frame.width * frame.height;
+    const buffer = uncompressLZ4( frame.payload, image_size, src_image.format );
+    return Object.assign( {}, src_image, { buffer, width: frame.width, height: frame.height, level: frame.level } );
+}
+
+// Matches the sizes the server gives the levels of a pyramid.
+function getLevelExtent( extent, level ) {
+    for( let i = 0; i < level; i++ ) {
+        extent = Math.max( Math.floor( extent / 2 ), 1 );
     }
-    return convertArrayView( view, format );
+    return extent;
 }
 
 function applyWindow( window_level, window_width, value ) {
@@ -68,7 +89,7 @@ function calcWindowInfo( image ) {
     }
 
     let min_value = Number.MAX_VALUE;
-    let max_value = Number.MIN_VALUE;
+    let max_value = -Number.MAX_VALUE;
 
     const image_pixels = image.width * image.height;
     for( let i = 0; i < image_pixels; i++ )
@@ -82,10 +103,40 @@ function calcWindowInfo( image ) {
     return { width: window_width, level: window_level };
 }
 
+function renderImage( org_image, view_image, window_level, window_width, opacity ) {
+    const image_pixels = org_image.width * org_image.height;
+    const pixel_step = getChannelsPerPixel( org_image.format );
+    const channel_step = ( 1 < pixel_step ) ? 1 : 0;
+    const has_alpha = ( pixel_step == 4) ? true : false;
+    if( has_alpha ) {
+        for( let i = 0; i < image_pixels; i++ )
+        {
+            view_image.data[ 4 * i + 0 ] = applyWindow( window_level, window_width, org_image.buffer[ pixel_step * i + 0 * channel_step ] );
+            view_image.data[ 4 * i + 1 ] = applyWindow( window_level, window_width, org_image.buffer[ pixel_step * i + 1 * channel_step ] );
+            view_image.data[ 4 * i + 2 ] = applyWindow( window_level, window_width, org_image.buffer[ pixel_step * i + 2 * channel_step ] );
+            view_image.data[ 4 * i + 3 ] = org_image.buffer[ pixel_step * i + 3 * channel_step ] * opacity / 255;
+        }
+    }
+    else {
+        for( let i = 0; i < image_pixels; i++ )
+        {
+            view_image.data[ 4 * i + 0 ] = applyWindow( window_level, window_width, org_image.buffer[ pixel_step * i + 0 * channel_step ] );
+            view_image.data[ 4 * i + 1 ] = applyWindow( window_level, window_width, org_image.buffer[ pixel_step * i + 1 * channel_step ] );
+            view_image.data[ 4 * i + 2 ] = applyWindow( window_level, window_width, org_image.buffer[ pixel_step * i + 2 * channel_step ] );
+            view_image.data[ 4 * i + 3 ] = opacity;
+        }
+    }
+
+    return createImageBitmap( view_image );
+}
+
 class SdvizImage extends Konva.Image {
     static get RGB_888() { return 0; }
     static get UINT_8() { return 1; }
     static get UINT_16() { return 2; }
+    // The server sends BGR_888, BGRA_8888 and FLOAT_32 images converted to these formats.
+    static get RGBA_8888() { return 5; }
+    static get INT_16() { return 6; }
 
     get window_level() {
         return this.wl;
@@ -95,14 +146,40 @@ class SdvizImage extends Konva.Image {
         return this.ww;
     }
 
-    constructor( org_image, opacity, ctx ) {
+    // source tells where the image comes from, for fetching finer levels of its pyramid.
+    constructor( src_image, opacity, ctx, source ) {
         super();
-        const image_size = this.getImageSize( org_image );
-        org_image.buffer = uncompressLZ4( org_image.buffer, image_size, org_image.format );
+        let org_image = decoded_images.get( src_image );
+        if( !org_image ) {
+            const frame = {
+                level: src_image.level || 0,
+                width: src_image.frame_width || src_image.width,
+                height: src_image.frame_height || src_image.height,
+                payload: src_image.buffer
+            };
+            org_image = decodeImage( src_image, frame );
+            decoded_images.set( src_image, org_image );
+        }
 
-        this.org_image = org_image;
+        this.src_image = src_image;
+        this.source = source;
+        // Tiles of a tiled image by level, column and row, the least recently shown first.
+        this.tiles = new Map();
+        this.visible_tiles = new Set();
+        this.ctx = ctx;
         this.opacity = opacity;
-        this.view_image = ctx.createImageData( org_image.width, org_image.height ); 
+        this.width( src_image.width );
+        this.height( src_image.height );
+        this.setOrgImage( org_image );
+    }
+
+    // Windowing set by the user is kept when a finer level replaces the pixels.
+    setOrgImage( org_image ) {
+        this.org_image = org_image;
+        this.view_image = this.ctx.createImageData( org_image.width, org_image.height );
+        if( this.org_window_width !== undefined ) {
+            return;
+        }
 
         const window_info = calcWindowInfo( this.org_image );
         this.wl= window_info.level;
@@ -110,40 +187,159 @@ class SdvizImage extends Konva.Image {
         this.org_window_width = window_info.width;
     }
 
-    getImageSize( { width, height, format } ) {
-        return getChannelsPerPixel(format) * getBytesPerChannel(format) * width * height;
+    // Fetches the finest pyramid level the image makes use of at the given stage scale, only
+    // the tiles of it within view_rect for a tiled image. Resolves to whether the image has to
+    // be drawn again.
+    refine( scale, view_rect ) {
+        const levels = this.src_image.levels || 1;
+        const wanted_level = Math.max( 0, Math.min( levels - 1, Math.floor( Math.log2( 1 / ( scale * window.devicePixelRatio ) ) ) ) );
+        if( !this.source ) {
+            return Promise.resolve( false );
+        }
+
+        if( this.src_image.tile_size ) {
+            return Promise.resolve( this.showTiles( wanted_level, view_rect ) );
+        }
+
+        if( this.org_image.level <= wanted_level ) {
+            return Promise.resolve( false );
+        }
+
+        const { ws, id, version, index } = this.source;
+        return requestImageFrame( ws, id, version, index, wanted_level ).then( ( frame ) => {
+            if( this.org_image.level <= frame.level ) {
+                return false;
+            }
+
+            const org_image = decodeImage( this.src_image, frame );
+            decoded_images.set( this.src_image, org_image );
+            this.setOrgImage( org_image );
+            return this.update().then( () => true );
+        });
     }
 
-    update( window_level, window_width ) {
-        this.wl= window_level || this.window_level;
-        this.ww= Math.max(0, window_width) || this.window_width;
+    // Shows the tiles of the level covering view_rect and hides the others, over the coarse
+    // pixels of the image. Missing tiles are requested and drawn as they arrive.
+    // Returns whether any tile has been shown or hidden.
+    showTiles( level, view_rect ) {
+        const visible_tiles = new Set();
+        if( level < this.org_image.level ) {
+            const { width, height, tile_size } = this.src_image;
+            const level_width = getLevelExtent( width, level );
+            const level_height = getLevelExtent( height, level );
+            const tile_width = tile_size * width / level_width;
+            const tile_height = tile_size * height / level_height;
+            const first_column = Math.max( 0, Math.floor( ( view_rect.x - this.x() ) / tile_width ) );
+            const first_row = Math.max( 0, Math.floor( ( view_rect.y - this.y() ) / tile_height ) );
+            const last_column = Math.min( Math.ceil( level_width / tile_size ) - 1, Math.floor( ( view_rect.x + view_rect.width - this.x() ) / tile_width ) );
+            const last_row = Math.min( Math.ceil( level_height / tile_size ) - 1, Math.floor( ( view_rect.y + view_rect.height - this.y() ) / tile_height ) );
+            for( let row = first_row; row <= last_row; row++ ) {
+                for( let column = first_column; column <= last_column; column++ ) {
+                    const key = `${level}/${column}/${row}`;
+                    visible_tiles.add( key );
+
+                    const tile = this.tiles.get( key );
+                    if( tile ) {
+                        this.tiles.delete( key );
+                        this.tiles.set( key, tile );
+                    }
+                    else {
+                        this.fetchTile( key, level, column, row, tile_width, tile_height );
+                    }
+                }
+            }
+        }
 
-        const image_pixels = this.org_image.width * this.org_image.height;
-        const pixel_step = getChannelsPerPixel( this.org_image.format );
-        const channel_step = ( 1 < pixel_step ) ? 1 : 0;
-        const has_alpha = ( pixel_step == 4) ? true : false;
-        if( has_alpha ) {
-            for( let i = 0; i < image_pixels; i++ )
-            {
-                this.view_image.data[ 4 * i + 0 ] = applyWindow( this.window_level, this.window_width, this.org_image.buffer[ pixel_step * i + 0 * channel_step ] );
-                this.view_image.data[ 4 * i + 1 ] = applyWindow( this.window_level, this.window_width, this.org_image.buffer[ pixel_step * i + 1 * channel_step ] );
-                this.view_image.data[ 4 * i + 2 ] = applyWindow( this.window_level, this.window_width, this.org_image.buffer[ pixel_step * i + 2 * channel_step ] );
-                this.view_image.data[ 4 * i + 3 ] = this.org_image.buffer[ pixel_step * i + 3 * channel_step ];
+        this.visible_tiles = visible_tiles;
+        let is_changed = false;
+        this.tiles.forEach( ( tile, key ) => {
+            const is_visible = visible_tiles.has( key );
+            if( tile.node.visible() !== is_visible ) {
+                is_changed = true;
+                tile.node.visible( is_visible );
             }
+            if( is_visible ) {
+                this.renderTile( tile ).then( ( is_rendered ) => is_rendered && this.drawLayer() );
+            }
+        });
+        this.evictTiles();
+        return is_changed;
+    }
+
+    fetchTile( key, level, column, row, tile_width, tile_height ) {
+        const { ws, id, version, index } = this.source;
+        requestImageFrame( ws, id, version, index, level, [ column, row ] ).then( ( frame ) => {
+            const layer = this.getLayer();
+            if( !layer || this.tiles.has( key ) ) {
+                return;
+            }
+
+            const org_image = decodeImage( this.src_image, frame );
+            const node = new Konva.Image({
+                x: this.x() + column * tile_width,
+                y: this.y() + row * tile_height,
+                width: frame.width * tile_width / this.src_image.tile_size,
+                height: frame.height * tile_height / this.src_image.tile_size,
+                visible: this.visible_tiles.has( key ),
+                listening: false
+            });
+            const tile = { node, org_image, view_image: this.ctx.createImageData( frame.width, frame.height ) };
+            this.tiles.set( key, tile );
+            layer.add( node );
+            this.evictTiles();
+            if( node.visible() ) {
+                this.renderTile( tile ).then( () => this.drawLayer() );
+            }
+        });
+    }
+
+    // Renders a tile with the current windowing unless it is already. Resolves to whether it did.
+    renderTile( tile ) {
+        if( ( tile.window_level === this.window_level ) && ( tile.window_width === this.window_width ) ) {
+            return Promise.resolve( false );
         }
-        else {
-            for( let i = 0; i < image_pixels; i++ )
-            {
-                this.view_image.data[ 4 * i + 0 ] = applyWindow( this.window_level, this.window_width, this.org_image.buffer[ pixel_step * i + 0 * channel_step ] );
-                this.view_image.data[ 4 * i + 1 ] = applyWindow( this.window_level, this.window_width, this.org_image.buffer[ pixel_step * i + 1 * channel_step ] );
-                this.view_image.data[ 4 * i + 2 ] = applyWindow( this.window_level, this.window_width, this.org_image.buffer[ pixel_step * i + 2 * channel_step ] );
-                this.view_image.data[ 4 * i + 3 ] = this.opacity;
+
+        tile.window_level = this.window_level;
+        tile.window_width = this.window_width;
+        return renderImage( tile.org_image, tile.view_image, this.window_level, this.window_width, this.opacity ).then( ( bitmap ) => {
+            tile.node.setImage( bitmap );
+            return true;
+        });
+    }
+
+    evictTiles() {
+        for( const [ key, tile ] of this.tiles ) {
+            if( this.tiles.size <= MAX_CACHED_TILES ) {
+                break;
             }
+            if( !this.visible_tiles.has( key ) ) {
+                tile.node.destroy();
+                this.tiles.delete( key );
+            }
+        }
+    }
+
+    drawLayer() {
+        const layer = this.getLayer();
+        if( layer ) {
+            layer.draw();
         }
+    }
+
+    update( window_level, window_width ) {
+        this.wl= window_level || this.window_level;
+        this.ww= Math.max(0, window_width) || this.window_width;
+
+        const tile_promises = [];
+        this.tiles.forEach( ( tile, key ) => {
+            if( this.visible_tiles.has( key ) ) {
+                tile_promises.push( this.renderTile( tile ) );
+            }
+        });
 
-        return createImageBitmap( this.view_image ).then( ( bitmap ) => {
+        return renderImage( this.org_image, this.view_image, this.window_level, this.window_width, this.opacity ).then( ( bitmap ) => {
             this.setImage( bitmap );
-            return Promise.resolve( this );
+            return Promise.all( tile_promises ).then( () => this );
         });
     }
 
@@ -152,7 +348,7 @@ class SdvizImage extends Konva.Image {
     }
 }
 
-function createImageLayerPromise( command )
+function createImageLayerPromise( command, source )
 {
     const src_image = command.args[0];
     const left_position = command.args[1];
@@ -161,7 +357,7 @@ function createImageLayerPromise( command )
 
     const layer = new Konva.Layer();
     const ctx = layer.getContext();
-    const image = new SdvizImage( src_image, opacity, ctx );
+    const image = new SdvizImage( src_image, opacity, ctx, source );
     return image.update().then( ( image_node ) => {
         layer.add( image_node );
         return Promise.resolve( layer );
@@ -334,9 +530,11 @@ class CanvasElement extends ElementComponent {
     constructor( props, context ) {
         super( props, context );
 
+        this.ws = props.ws;
         this.resizeListener = ( e ) => {
             this.updatePosition();
             this.stage.draw();
+            this.refineImages();
         };
         this.mousedownListener = ( e ) => {
             this.modifier_key_status = this.stage ? getModifierKeyStatus( e.evt.shiftKey, e.evt.ctrlKey ) : -1;
@@ -366,6 +564,7 @@ class CanvasElement extends ElementComponent {
                                                      this.stage.height() );
                 this.stage.offset( clipped_offset );
                 this.stage.draw();
+                this.refineImages();
             } else if( this.modifier_key_status == 1 ) {
                 const next_scale = ( movement_y / UNIT_SCALE_DIST ) + this.stage.scaleY();
                 const next_clipped_scale = clipScale( next_scale,
@@ -385,12 +584,9 @@ class CanvasElement extends ElementComponent {
                                                      this.stage.height() );
                 this.stage.offset( clipped_offset );
                 this.stage.draw();
+                this.refineImages();
             } else if( this.modifier_key_status == 2 ) {
-                const update_image_node_promises = this.stage.getLayers()
-                    .reduce( ( prev, cur ) => {
-                        Array.prototype.push.apply( prev, cur.getChildren( n => n.getClassName() === 'Image' ) ); 
-                        return prev;
-                    }, [] )
+                const update_image_node_promises = this.getImageNodes()
                     .map( node => {
                         const next_window_level = node.calcWindowDisplacement( movement_y ) + node.window_level;
                         const next_window_width = -node.calcWindowDisplacement( movement_x ) + node.window_width;
@@ -428,6 +624,11 @@ class CanvasElement extends ElementComponent {
         this.stage.draw();
     }
 
+    componentWillUpdate( nextProps ) {
+        super.componentWillUpdate( nextProps );
+        this.ws = nextProps.ws;
+    }
+
     componentWillUnmount() {
         window.removeEventListener( 'resize', this.resizeListener );
         document.removeEventListener( 'mouseup', this.mouseupListener );
@@ -458,11 +659,33 @@ class CanvasElement extends ElementComponent {
         this.stage.offset( clipped_offset );
     }
 
+    getImageNodes() {
+        return this.stage.getLayers()
+            .reduce( ( prev, cur ) => {
+                Array.prototype.push.apply( prev, cur.getChildren( n => n instanceof SdvizImage ) );
+                return prev;
+            }, [] );
+    }
+
+    refineImages() {
+        const scale = this.stage.scaleX();
+        const view_rect = {
+            x: this.stage.offsetX() - this.stage.x() / scale,
+            y: this.stage.offsetY() - this.stage.y() / scale,
+            width: this.stage.width() / scale,
+            height: this.stage.height() / scale
+        };
+        this.getImageNodes().forEach( ( node ) => {
+            node.refine( scale, view_rect ).then( ( is_refined ) => is_refined && this.stage.draw() );
+        });
+    }
+
     updateContent() {
-        Promise.all( this.value.commands.map( ( command ) => {
+        Promise.all( this.value.commands.map( ( command, index ) => {
             if( command.func === 'image' )
             {
-                return createImageLayerPromise( command );
+                const source = { ws: this.ws, id: this.id, version: this.version, index };
+                return createImageLayerPromise( command, source );
             }
             else if( command.func === 'rect' )
             {
@@ -483,7 +706,9 @@ class CanvasElement extends ElementComponent {
 
             throw new Error( "Unknow canvas command." );
         })).then( ( layers ) => {
+            this.stage.destroyChildren();
             layers.forEach( ( layer ) => { this.stage.add( layer ); });
+            this.refineImages();
         });
     }
 
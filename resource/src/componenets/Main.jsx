@@ -4,6 +4,7 @@ import * as Resources from '../constants/Resources';
 import Loader from 'react-loader';
 import ContainerElement from './ContainerElement';
 import msgpack from 'msgpack-lite';
+import { isImageFrame, storeImageFrame } from '../store/image-frames';
 
 class Main extends React.Component {
     constructor( props ) {
@@ -28,7 +29,14 @@ class Main extends React.Component {
                 this.ws.binaryType = 'arraybuffer';
                 this.ws.onopen = (e) => this.actions.connectSuccess();
                 this.ws.onerror = (e) => this.actions.connectError( msgpack.decode( new Uint8Array( e.data ) ) );
-                this.ws.onmessage = (e) => this.actions.syncValue( msgpack.decode( new Uint8Array( e.data ) ) );
+                this.ws.onmessage = (e) => {
+                    const data = new Uint8Array( e.data );
+                    if( isImageFrame( data ) ) {
+                        storeImageFrame( data );
+                        return;
+                    }
+                    this.actions.syncValue( msgpack.decode( data ) );
+                };
             });
     }
 
@@ -1 +1 @@
-export const PAGE_ID = '__page__';
+export const PAGE_ID = 1;
@@ -3,6 +3,44 @@ import { SET_VALUE, SYNC_VALUE } from '../constants/ActionTypes'
 const initialState = {
 };
 
+function applyValuePatch( value, { set = {}, erase = [], length, nested = {} } ) {
+    let new_value;
+    if( Array.isArray( value ) ) {
+        new_value = value.slice( 0, length );
+    }
+    else {
+        new_value = Object.assign( {}, value );
+        erase.forEach( ( key ) => delete new_value[key] );
+    }
+
+    for( const key in set ) {
+        new_value[key] = set[key];
+    }
+    for( const key in nested ) {
+        new_value[key] = applyValuePatch( new_value[key], nested[key] );
+    }
+
+    return new_value;
+}
+
+function applySync( element, { base_version, value_patch, ...fields } ) {
+    if( base_version === undefined ) {
+        return Object.assign( {}, element, fields );
+    }
+
+    if( !element || element.version !== base_version ) {
+        console.warn( `Delta for version ${base_version} does not match the local version.` );
+        return element;
+    }
+
+    const new_element = Object.assign( {}, element, fields );
+    if( value_patch !== undefined ) {
+        new_element.value = applyValuePatch( element.value, value_patch );
+    }
+
+    return new_element;
+}
+
 function elements( state = initialState, action ) {
     const { type, payload } = action;
 
@@ -11,7 +49,11 @@ function elements( state = initialState, action ) {
         case SYNC_VALUE:
             const new_state = Object.assign( {}, state );
             for( const id in payload ) {
-                new_state[id] = Object.assign( {}, new_state[id], payload[id] );
+                if( payload[id].removed ) {
+                    delete new_state[id];
+                    continue;
+                }
+                new_state[id] = applySync( new_state[id], payload[id] );
             }
 
             return new_state;
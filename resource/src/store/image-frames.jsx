@@ -0,0 +1,186 @@
+import msgpack from 'msgpack-lite';
+
+// Pixel payloads arrive as raw binary frames just before the message referring to them.
+// See sdviz/serdes.cpp for the frame layout.
+const IMAGE_FRAME_MAGIC = 0xc1;
+const IMAGE_FRAME_HEADER_SIZE = 32;
+
+// Frames which reached the client before the message referring to them. Those of versions
+// the client has moved past are dropped, as no message will refer to them anymore.
+const pending_frames = new Map();
+// Pyramid levels and tiles asked for and not received yet. A request is sent again once it
+// timed out, as the server drops frames it has no room for.
+const frame_requests = new Map();
+const FRAME_REQUEST_TIMEOUT = 2000;
+
+function frameKey( id, version, index ) {
+    return `${id}/${version}/${index}`;
+}
+
+function levelKey( id, version, index, level, tile ) {
+    const key = `${id}/${version}/${index}/${level}`;
+    return tile ? `${key}/${tile[0]}/${tile[1]}` : key;
+}
+
+function isImageHandle( obj ) {
+    return ( typeof obj.frame === 'number' ) && ( obj.format !== undefined );
+}
+
+export function isImageFrame( data ) {
+    return ( 0 < data.length ) && ( data[0] === IMAGE_FRAME_MAGIC );
+}
+
+export function storeImageFrame( data ) {
+    const view = new DataView( data.buffer, data.byteOffset, data.byteLength );
+    const id = view.getUint32( 4, true );
+    const version = view.getUint32( 8, true );
+    const index = view.getUint32( 12, true );
+    const frame = {
+        level: data[2],
+        width: view.getUint32( 16, true ),
+        height: view.getUint32( 20, true ),
+        tile: ( data[3] === 1 ) ? [ view.getUint32( 24, true ), view.getUint32( 28, true ) ] : null,
+        payload: data.subarray( IMAGE_FRAME_HEADER_SIZE )
+    };
+
+    const request_key = levelKey( id, version, index, frame.level, frame.tile );
+    const request = frame_requests.get( request_key );
+    if( request ) {
+        frame_requests.delete( request_key );
+        request.resolve( frame );
+        return;
+    }
+
+    // Tiles are only ever sent on request.
+    if( !frame.tile ) {
+        dropStaleImageFrames( id, version );
+        pending_frames.set( frameKey( id, version, index ), Object.assign( frame, { id, version } ) );
+    }
+}
+
+// Drops the pending frames of an element older than version.
+export function dropStaleImageFrames( id, version ) {
+    pending_frames.forEach( ( frame, key ) => {
+        if( ( frame.id === Number( id ) ) && ( frame.version < version ) ) {
+            pending_frames.delete( key );
+        }
+    });
+}
+
+// Asks the server for a level of the pyramid of an image, or for the tile [ column, row ] of it.
+// The promise resolves with the frame, or never when the canvas has moved on to another version
+// in the meantime.
+export function requestImageFrame( ws, id, version, index, level, tile ) {
+    const key = levelKey( id, version, index, level, tile );
+    let request = frame_requests.get( key );
+    if( request && ( Date.now() - request.time < FRAME_REQUEST_TIMEOUT ) ) {
+        return request.promise;
+    }
+
+    if( !request ) {
+        frame_requests.forEach( ( other, other_key ) => {
+            if( other.id === id && other.version !== version ) {
+                frame_requests.delete( other_key );
+            }
+        });
+
+        request = { id, version };
+        request.promise = new Promise( ( resolve ) => request.resolve = resolve );
+        frame_requests.set( key, request );
+    }
+
+    request.time = Date.now();
+    const message = { id: Number( id ), version, frame: index, level };
+    if( tile ) {
+        message.tile = tile;
+    }
+    ws.send( msgpack.encode( message ) );
+    return request.promise;
+}
+
+// Attaches the pending frames to the image handles found in obj. The compressed pixels stay
+// a view over the received message.
+export function resolveImageFrames( id, version, obj ) {
+    if( !obj || typeof obj !== 'object' ) {
+        return;
+    }
+
+    if( Array.isArray( obj ) ) {
+        obj.forEach( ( item ) => resolveImageFrames( id, version, item ) );
+        return;
+    }
+
+    if( isImageHandle( obj ) ) {
+        const key = frameKey( id, version, obj.frame );
+        const frame = pending_frames.get( key );
+        pending_frames.delete( key );
+        if( frame ) {
+            Object.assign( obj, { buffer: frame.payload, level: frame.level, frame_width: frame.width, frame_height: frame.height } );
+        }
+        return;
+    }
+
+    Object.keys( obj ).forEach( ( key ) => resolveImageFrames( id, version, obj[key] ) );
+}
+
+// Decodes one LZ4 block into output at out_pos. Matches may reach back into the blocks decoded
+// before it, as the server compresses the blocks of a frame as one stream.
+function decodeLZ4Block( input, start, end, output, out_pos ) {
+    let i = start;
+    let j = out_pos;
+    while( i < end ) {
+        const token = input[i++];
+
+        let literals = token >> 4;
+        if( literals === 15 ) {
+            let extra;
+            do {
+                extra = input[i++];
+                literals += extra;
+            } while( extra === 255 );
+        }
+        output.set( input.subarray( i, i + literals ), j );
+        i += literals;
+        j += literals;
+
+        // The last sequence of a block carries literals only.
+        if( end <= i ) {
+            break;
+        }
+
+        const offset = input[i] | ( input[i + 1] << 8 );
+        i += 2;
+
+        let length = token & 15;
+        if( length === 15 ) {
+            let extra;
+            do {
+                extra = input[i++];
+                length += extra;
+            } while( extra === 255 );
+        }
+        length += 4;
+
+        // Byte by byte, since a match may overlap the bytes it produces.
+        for( let k = j - offset, stop = j + length; j < stop; ) {
+            output[j++] = output[k++];
+        }
+    }
+
+    return j;
+}
+
+// Decodes the size prefixed LZ4 blocks of a frame payload into output.
+export function decodeImageFrame( payload, output ) {
+    const view = new DataView( payload.buffer, payload.byteOffset, payload.byteLength );
+    let i = 0;
+    let j = 0;
+    while( i + 4 <= payload.length ) {
+        const block_size = view.getUint32( i, true );
+        i += 4;
+        j = decodeLZ4Block( payload, i, i + block_size, output, j );
+        i += block_size;
+    }
+
+    return j;
+}
@@ -2,8 +2,11 @@
 # define __SDVIZ_ACTION_HPP__
 
 # include <string>
+# include <vector>
+# include <type_traits>
 
 # include "element_impl.hpp"
+# include "fence.hpp"
 
 namespace sdviz
 {
@@ -14,7 +17,7 @@ namespace sdviz
             using payload_type = PayloadType;
 
             template< typename... ArgTypes >
-            Action( std::string const& _target_id, ArgTypes&&... _args )
+            Action( element_id_type const _target_id, ArgTypes&&... _args )
                 : target_id{ _target_id },
                   payload( std::move( _args )... )
             {}
@@ -25,7 +28,7 @@ namespace sdviz
             Action& operator =( Action const& ) = delete;
             Action& operator =( Action&& ) = default;
 
-            std::string const target_id;
+            element_id_type const target_id;
             payload_type  payload;
     };
 
@@ -36,9 +39,62 @@ namespace sdviz
         using set_param_type = Action< typename ElementImplType::param_type >;
     };
 
-    using AddElementImplAction = Action< std::tuple< int, std::string > >;
+    template< typename ActionType >
+    struct IsSetValueAction
+    {
+        static constexpr bool value = std::is_same< ActionType, ActionTypeTraits< TextElementImpl >::set_value_type >::value
+                                   || std::is_same< ActionType, ActionTypeTraits< CanvasElementImpl >::set_value_type >::value
+                                   || std::is_same< ActionType, ActionTypeTraits< ChartElementImpl >::set_value_type >::value
+                                   || std::is_same< ActionType, ActionTypeTraits< ButtonElementImpl >::set_value_type >::value
+                                   || std::is_same< ActionType, ActionTypeTraits< SliderElementImpl >::set_value_type >::value;
+    };
+
+    // Elements to be sent to a connection; all of them when target_ids is empty.
+    struct SyncRequest
+    {
+        std::string connection_id;
+        std::vector< element_id_type > target_ids;
+    };
+
+    // Stands in the queue for a set-value action parked in the overflow mailbox of the Context,
+    // keeping the place and lane of the element's first overflowing update.
+    struct OverflowSlot
+    {
+        size_t lane;
+    };
+
+    // Deletes an element. It travels in the lane of the element, behind the actions queued for it.
+    struct DeleteRequest
+    {
+        size_t lane;
+    };
+
+    // Follows the actions issued before it through the Context and the sessions.
+    struct FenceRequest
+    {
+        fence_ptr_type fence;
+    };
+
+    // A client asking for a level of the pyramid of an image drawn on a canvas, or for one tile
+    // of it. It is answered only while the canvas is still at the version the client has.
+    struct FrameRequest
+    {
+        std::string connection_id;
+        int version;
+        int command_index;
+        int level;
+        bool is_tile;
+        int tile_column;
+        int tile_row;
+    };
+
+    using AddElementImplAction = Action< std::tuple< int, element_id_type > >;
     using CreateElementImplAction = Action< ElementImplVariant >;
-    using SyncAction = Action< std::nullptr_t >;
+    using SyncAction = Action< SyncRequest >;
+    using OverflowAction = Action< OverflowSlot >;
+    using FenceAction = Action< FenceRequest >;
+    using DeleteElementImplAction = Action< DeleteRequest >;
+    using FrameRequestAction = Action< FrameRequest >;
     using ActionVariant = boost::variant<
         ActionTypeTraits< TextElementImpl >::set_value_type,
         ActionTypeTraits< TextElementImpl >::set_param_type,
@@ -52,8 +108,24 @@ namespace sdviz
         ActionTypeTraits< SliderElementImpl >::set_param_type,
         AddElementImplAction,
         CreateElementImplAction,
-        SyncAction
+        SyncAction,
+        OverflowAction,
+        FenceAction,
+        DeleteElementImplAction,
+        FrameRequestAction
     >;
+
+    // Actions on an element share its lane so that they stay in order. Creation and layout
+    // changes are always control actions, which keeps them ahead of any later bulk action.
+    template< typename ActionType > struct ActionLane { static constexpr Lane value = ControlLane; };
+    template<> struct ActionLane< ActionTypeTraits< CanvasElementImpl >::set_value_type > { static constexpr Lane value = ElementLane< CanvasElementImpl >::value; };
+    template<> struct ActionLane< ActionTypeTraits< CanvasElementImpl >::set_param_type > { static constexpr Lane value = ElementLane< CanvasElementImpl >::value; };
+    template<> struct ActionLane< ActionTypeTraits< ChartElementImpl >::set_value_type > { static constexpr Lane value = ElementLane< ChartElementImpl >::value; };
+    template<> struct ActionLane< ActionTypeTraits< ChartElementImpl >::set_param_type > { static constexpr Lane value = ElementLane< ChartElementImpl >::value; };
+    template<> struct ActionLane< SyncAction > { static constexpr Lane value = BulkLane; };
+    template<> struct ActionLane< FrameRequestAction > { static constexpr Lane value = ElementLane< CanvasElementImpl >::value; };
+    // The last lane is served last, so a fence trails every action queued before it.
+    template<> struct ActionLane< FenceAction > { static constexpr Lane value = BulkLane; };
 }
 
 #endif // __SDVIZ_ACTION_HPP__
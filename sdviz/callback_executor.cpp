@@ -0,0 +1,170 @@
+#include <algorithm>
+
+#include "callback_executor.hpp"
+#include "log.hpp"
+
+using namespace sdviz;
+
+CallbackExecutor& CallbackExecutor::getInstance()
+{
+    static CallbackExecutor executor;
+    return executor;
+}
+
+CallbackExecutor::~CallbackExecutor()
+{
+    stop();
+}
+
+void CallbackExecutor::start( Config const& _config )
+{
+    stop();
+
+    std::lock_guard< std::mutex > lock( mutex );
+    is_serial = _config.serial_callbacks_per_element;
+    is_running = true;
+    int const callback_threads = std::max( 0, _config.callback_threads );
+    for( int i = 0; i < callback_threads; ++i )
+    {
+        workers.emplace_back( [this](){ loop(); } );
+    }
+}
+
+void CallbackExecutor::stop()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        is_running = false;
+    }
+    cond.notify_all();
+
+    for( auto& worker : workers )
+    {
+        worker.join();
+    }
+    workers.clear();
+    tasks.clear();
+    keyed_tasks.clear();
+    pending_changes.clear();
+}
+
+void CallbackExecutor::post( element_id_type const _key, task_type&& _task )
+{
+    std::unique_lock< std::mutex > lock( mutex );
+    if( workers.empty() )
+    {
+        lock.unlock();
+        run( _task );
+        return;
+    }
+
+    if( !is_serial )
+    {
+        lock.unlock();
+        enqueue( std::move( _task ) );
+        return;
+    }
+
+    lock.unlock();
+    postKeyed( _key, std::move( _task ) );
+}
+
+// Only the head of an element's queue is ever scheduled, the next one follows once it is done.
+void CallbackExecutor::postKeyed( element_id_type const _key, task_type&& _task )
+{
+    std::unique_lock< std::mutex > lock( mutex );
+    auto& key_tasks = keyed_tasks[ _key ];
+    key_tasks.emplace_back( std::move( _task ) );
+    bool const is_head = ( key_tasks.size() == 1 );
+    lock.unlock();
+
+    if( is_head )
+    {
+        enqueue( [this, _key](){ runKeyed( _key ); } );
+    }
+}
+
+CallbackExecutor::CallbackExecutor()
+    : is_serial( true ),
+      is_running( false )
+{
+}
+
+void CallbackExecutor::enqueue( task_type&& _task )
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        tasks.emplace_back( std::move( _task ) );
+    }
+    cond.notify_one();
+}
+
+void CallbackExecutor::runKeyed( element_id_type const _key )
+{
+    task_type task;
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        task = keyed_tasks.at( _key ).front();
+    }
+
+    run( task );
+
+    bool has_next = false;
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        auto const key_tasks_it = keyed_tasks.find( _key );
+        if( key_tasks_it == std::end( keyed_tasks ) )
+        {
+            return;
+        }
+
+        key_tasks_it->second.pop_front();
+        has_next = !key_tasks_it->second.empty();
+        if( !has_next )
+        {
+            keyed_tasks.erase( key_tasks_it );
+        }
+    }
+
+    if( has_next )
+    {
+        enqueue( [this, _key](){ runKeyed( _key ); } );
+    }
+}
+
+void CallbackExecutor::loop()
+{
+    while( true )
+    {
+        task_type task;
+        {
+            std::unique_lock< std::mutex > lock( mutex );
+            cond.wait( lock, [this](){ return !is_running || !tasks.empty(); } );
+            if( !is_running )
+            {
+                return;
+            }
+
+            task = std::move( tasks.front() );
+            tasks.pop_front();
+        }
+
+        run( task );
+    }
+}
+
+void CallbackExecutor::run( task_type const& _task )
+{
+    try
+    {
+        _task();
+    }
+    catch( std::exception& e )
+    {
+        LOG(error) << e.what();
+    }
+    catch( ... )
+    {
+        LOG(error) << "Exception catched.";
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef __SDVIZ_CALLBACK_EXECUTOR_HPP__
+# define __SDVIZ_CALLBACK_EXECUTOR_HPP__
+
+# include <deque>
+# include <functional>
+# include <memory>
+# include <mutex>
+# include <condition_variable>
+# include <thread>
+# include <unordered_map>
+# include <vector>
+
+# include "sdviz.hpp"
+
+namespace sdviz
+{
+    // Runs user callbacks off the Context loop on a pool of worker threads. With serial
+    // execution the callbacks of one element run one at a time in posting order; callbacks
+    // of different elements still run concurrently. Without worker threads callbacks run
+    // inline on the posting thread.
+    // A coalescing change waits behind the running callback of its element; changes posted
+    // meanwhile are merged into it, so the callback sees the oldest and the newest value only.
+    class CallbackExecutor final
+    {
+        public:
+            using task_type = std::function< void() >;
+
+            CallbackExecutor( CallbackExecutor const& ) = delete;
+            CallbackExecutor( CallbackExecutor&& ) = delete;
+            ~CallbackExecutor();
+
+            CallbackExecutor& operator =( CallbackExecutor const& ) = delete;
+            CallbackExecutor& operator =( CallbackExecutor&& ) = delete;
+
+            static CallbackExecutor& getInstance();
+            void start( Config const& _config );
+            void stop();
+            void post( element_id_type const _key, task_type&& _task );
+
+            template< typename ValueType >
+            void postChange( element_id_type const _key,
+                             std::function< void( ValueType, ValueType ) > const& _callback,
+                             ValueType const& _current,
+                             ValueType const& _next,
+                             bool const _is_coalescing );
+
+        private:
+            template< typename ValueType >
+            struct Change
+            {
+                ValueType current;
+                ValueType next;
+            };
+
+            void postKeyed( element_id_type const _key, task_type&& _task );
+            CallbackExecutor();
+            void enqueue( task_type&& _task );
+            void runKeyed( element_id_type const _key );
+            void loop();
+
+            static void run( task_type const& _task );
+
+            std::vector< std::thread > workers;
+            std::deque< task_type > tasks;
+            std::unordered_map< element_id_type, std::deque< task_type > > keyed_tasks;
+            std::unordered_map< element_id_type, std::shared_ptr< void > > pending_changes;
+            bool is_serial;
+            bool is_running;
+            std::mutex mutex;
+            std::condition_variable cond;
+    };
+
+    template< typename ValueType >
+    void CallbackExecutor::postChange( element_id_type const _key,
+                                       std::function< void( ValueType, ValueType ) > const& _callback,
+                                       ValueType const& _current,
+                                       ValueType const& _next,
+                                       bool const _is_coalescing )
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        if( !_is_coalescing || workers.empty() )
+        {
+            lock.unlock();
+            post( _key, [_callback, _current, _next](){ _callback( _current, _next ); } );
+            return;
+        }
+
+        // An element always posts changes of the same value type, so the cast is safe.
+        auto const pending_it = pending_changes.find( _key );
+        if( pending_it != std::end( pending_changes ) )
+        {
+            std::static_pointer_cast< Change< ValueType > >( pending_it->second )->next = _next;
+            return;
+        }
+
+        auto change = std::make_shared< Change< ValueType > >( Change< ValueType >{ _current, _next } );
+        pending_changes.emplace( _key, change );
+        lock.unlock();
+
+        postKeyed( _key, [this, _key, _callback, change](){
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                pending_changes.erase( _key );
+            }
+            _callback( change->current, change->next );
+        });
+    }
+}
+
+#endif // __SDVIZ_CALLBACK_EXECUTOR_HPP__
@@ -26,6 +26,11 @@ std::vector< sdviz::CanvasImpl::CanvasCommandVariant >::const_iterator sdviz::Ca
     return commands.cend();
 }
 
+size_t sdviz::CanvasImpl::size() const noexcept
+{
+    return commands.size();
+}
+
 std::string const sdviz::CanvasImpl::LinePolicy::func_name = "line";
 std::string const sdviz::CanvasImpl::CirclePolicy::func_name = "circle";
 std::string const sdviz::CanvasImpl::ImagePolicy::func_name = "image";
@@ -57,11 +57,16 @@ namespace sdviz
                     {
                     }
 
-                    param_type getParam() const noexcept
+                    param_type const& getParam() const noexcept
                     {
                         return param;
                     }
 
+                    bool operator ==( CanvasCommand const& _command ) const
+                    {
+                        return param == _command.param;
+                    }
+
                 private:
                     param_type param;
             };
@@ -98,6 +103,7 @@ namespace sdviz
             int getHeight() const noexcept;
             std::vector< CanvasCommandVariant >::const_iterator cbegin() const noexcept;
             std::vector< CanvasCommandVariant >::const_iterator cend() const noexcept;
+            size_t size() const noexcept;
 
             CanvasImpl& operator =( CanvasImpl const& _impl ) = default;
             CanvasImpl& operator =( CanvasImpl&& _impl ) = default;
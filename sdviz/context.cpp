@@ -1,48 +1,147 @@
+#include <algorithm>
+#include <deque>
+#include <iterator>
 #include <tuple>
+#include <unordered_map>
 
 #include "./action.hpp"
 #include "./context.hpp"
 #include "./log.hpp"
-#include "./model_sync_server.hpp"
 #include "./resource.hpp"
 #include "./serdes.hpp"
+#include "./update_encoder.hpp"
 #include "./visitor.hpp"
 #include "./variant_util.hpp"
 
 using namespace sdviz;
 
+namespace
+{
+    element_id_type getTargetId( ActionVariant const& _action )
+    {
+        auto target_visitor = makeVariantVisitor< element_id_type >([]( auto const& _action ){
+            return _action.target_id;
+        });
+        return boost::apply_visitor( target_visitor, _action );
+    }
+
+    double getMaxPublishRate( element_id_type const _target_id )
+    {
+        auto const element_impl_variant = element_store.find( _target_id );
+        if( !element_impl_variant )
+        {
+            return 0.0;
+        }
+        return boost::apply_visitor( MaxPublishRateVisitor{}, *element_impl_variant );
+    }
+
+    bool isCoalescible( element_id_type const _target_id )
+    {
+        auto const element_impl_variant = element_store.find( _target_id );
+        return element_impl_variant && boost::apply_visitor( IsCoalescibleVisitor{}, *element_impl_variant );
+    }
+
+    // Marks set-value actions which are followed by another set-value action for the same element
+    // with nothing else happening to that element in between. Only the last one of such a run
+    // has to be applied and serialized.
+    std::vector< bool > findCoalescedActions( std::deque< Context::action_queue_type::value_type > const& _actions )
+    {
+        std::vector< bool > is_coalesced( _actions.size(), false );
+        std::unordered_map< element_id_type, size_t > last_set_values;
+        for( size_t i = 0; i < _actions.size(); ++i )
+        {
+            auto const& action = std::get<0>( _actions[i] );
+            bool const is_sync_with_client = std::get<1>( _actions[i] );
+            auto const target_id = getTargetId( action );
+            bool const is_set_value = boost::apply_visitor( IsSetValueActionVisitor{}, action )
+                                   && isCoalescible( target_id );
+
+            auto const last_it = last_set_values.find( target_id );
+            if( !is_set_value )
+            {
+                if( last_it != std::end( last_set_values ) )
+                {
+                    last_set_values.erase( last_it );
+                }
+                continue;
+            }
+
+            if( last_it != std::end( last_set_values ) )
+            {
+                auto const& last = _actions[ last_it->second ];
+                bool const is_same_kind = ( std::get<0>( last ).which() == action.which() )
+                                       && ( std::get<1>( last ) == is_sync_with_client );
+                is_coalesced[ last_it->second ] = is_same_kind;
+            }
+            last_set_values[ target_id ] = i;
+        }
+
+        return is_coalesced;
+    }
+}
+
+size_t ActionLanePolicy::operator()( std::tuple< ActionVariant, bool > const& _item ) const
+{
+    return boost::apply_visitor( ActionLaneVisitor{}, std::get<0>( _item ) );
+}
+
 Context& Context::getInstance()
 {
     static Context context;
     return context;
 }
 
-void Context::start()
+void Context::start( Config const& _config )
 {
     stop();
+    coalescing_interval = std::chrono::milliseconds( std::max( 0, _config.coalescing_interval_ms ) );
+    batch_latency = std::chrono::milliseconds( std::max( 0, _config.batch_latency_ms ) );
+    max_batch_updates = std::max( 1, _config.max_batch_updates );
+    max_queued_actions = std::max( 0, _config.max_queued_actions );
+    overflow_policy = _config.overflow_policy;
     loop_thread = std::thread([&](){
         is_loop.store( true, std::memory_order_release );
         while( is_loop.load( std::memory_order_acquire ) )
         {
-            auto& action = std::get<0>( action_queue_ptr->front() );
-            bool is_sync_with_client = std::get<1>( action_queue_ptr->front() );
+            if( !waitForAction() )
+            {
+                publishHeldActions();
+                publishUpdates();
+                continue;
+            }
+
+            std::deque< action_queue_type::value_type > actions;
+            popActions( actions );
 
-            try
+            // Drain whatever is queued, waiting for more within the coalescing and batching windows.
+            auto const deadline = std::chrono::steady_clock::now() + std::max( coalescing_interval, batch_latency );
+            while( ( actions.size() < max_batch_updates ) && action_queue_ptr->waitUntil( deadline ) )
             {
-                auto intermediate_result = boost::apply_visitor( ActionVisitor{}, action );
-                if( is_sync_with_client )
-                {
-                    ModelSyncServer::getInstance().sendAction( intermediate_result );
-                }
+                popActions( actions );
             }
-            catch( std::exception& e )
+
+            if( 0 < max_queued_actions )
             {
-                LOG(error) << e.what();
-                //TODO: show error modal
+                std::lock_guard< std::mutex > lock( overflow_mutex );
+                overflow_cond.notify_all();
             }
 
-            action_queue_ptr->pop();
+            auto const is_coalesced = ( 0 < coalescing_interval.count() ) ? findCoalescedActions( actions )
+                                                                          : std::vector< bool >( actions.size(), false );
+            for( size_t i = 0; i < actions.size(); ++i )
+            {
+                if( !is_coalesced[i] )
+                {
+                    dispatchAction( std::move( actions[i] ) );
+                }
+            }
+            publishHeldActions();
+            publishUpdates();
         }
+        held_actions.clear();
+        held_fences.clear();
+        outbox.clear();
+        next_publish_times.clear();
     });
 }
 
@@ -57,10 +156,30 @@ void Context::wait()
 void Context::stop()
 {
     is_loop.store( false, std::memory_order_release );
-    ActionVariant action{ SyncAction{ dummy_id, nullptr } };
+    ActionVariant action{ SyncAction{ dummy_id, SyncRequest{} } };
     action_queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+    {
+        std::lock_guard< std::mutex > lock( overflow_mutex );
+        overflow_cond.notify_all();
+    }
     wait();
     action_queue_ptr->clear();
+
+    std::lock_guard< std::mutex > lock( overflow_mutex );
+    overflow_actions.clear();
+}
+
+// Hands the update jobs of the current batch to the encoder, which sends them in this order
+// once they are serialized.
+void Context::publishUpdates()
+{
+    for( auto& receiver_jobs : outbox )
+    {
+        UpdateEncoder::getInstance().submit( std::get<0>( receiver_jobs ),
+                                             std::move( std::get<1>( receiver_jobs ) ),
+                                             std::move( std::get<2>( receiver_jobs ) ) );
+    }
+    outbox.clear();
 }
 
 std::shared_ptr< Context::action_queue_type > Context::getQueuePtr() const
@@ -70,6 +189,271 @@ std::shared_ptr< Context::action_queue_type > Context::getQueuePtr() const
 
 Context::Context()
     : action_queue_ptr( std::make_shared< action_queue_type>() ),
-      is_loop( false )
+      is_loop( false ),
+      coalescing_interval( 0 ),
+      batch_latency( 0 ),
+      max_batch_updates( 1 ),
+      max_queued_actions( 0 ),
+      overflow_policy( Config::Block )
+{
+}
+
+bool Context::pushAction( ActionVariant&& _action, bool const _is_sync_with_client )
+{
+    bool const is_bounded = ( 0 < max_queued_actions )
+                         && boost::apply_visitor( IsSetValueActionVisitor{}, _action )
+                         && ( std::this_thread::get_id() != loop_thread.get_id() );
+    if( !is_bounded )
+    {
+        action_queue_ptr->push( std::make_tuple( std::move( _action ), _is_sync_with_client ) );
+        return true;
+    }
+
+    switch( overflow_policy )
+    {
+        case Config::Block:
+        {
+            std::unique_lock< std::mutex > lock( overflow_mutex );
+            while( isQueueFull() && is_loop.load( std::memory_order_acquire ) )
+            {
+                overflow_cond.wait_for( lock, std::chrono::milliseconds( 10 ) );
+            }
+            break;
+        }
+        case Config::Reject:
+        {
+            if( isQueueFull() )
+            {
+                return false;
+            }
+            break;
+        }
+        case Config::DropOldest:
+        {
+            // Once an element has overflowed, its updates keep replacing the parked one until the
+            // marker is consumed, so a newer value never gets ahead of an older one.
+            auto const target_id = getTargetId( _action );
+            std::unique_lock< std::mutex > lock( overflow_mutex );
+            auto const overflow_it = overflow_actions.find( target_id );
+            if( overflow_it != std::end( overflow_actions ) )
+            {
+                overflow_it->second = std::make_unique< action_queue_type::value_type >( std::move( _action ), _is_sync_with_client );
+                return true;
+            }
+
+            if( !isQueueFull() )
+            {
+                break;
+            }
+
+            size_t const lane = boost::apply_visitor( ActionLaneVisitor{}, _action );
+            overflow_actions.emplace( target_id, std::make_unique< action_queue_type::value_type >( std::move( _action ), _is_sync_with_client ) );
+            lock.unlock();
+
+            ActionVariant marker{ OverflowAction{ target_id, OverflowSlot{ lane } } };
+            action_queue_ptr->push( std::make_tuple( std::move( marker ), _is_sync_with_client ) );
+            return true;
+        }
+    }
+
+    action_queue_ptr->push( std::make_tuple( std::move( _action ), _is_sync_with_client ) );
+    return true;
+}
+
+// A fence pushed while the loop is not running is released right away by the caller.
+void Context::pushFence( fence_ptr_type const& _fence )
+{
+    if( !is_loop.load( std::memory_order_acquire ) )
+    {
+        return;
+    }
+
+    ActionVariant action{ FenceAction{ dummy_id, FenceRequest{ _fence } } };
+    action_queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+}
+
+// Swaps out everything pending, up to the batch size, in one go.
+void Context::popActions( std::deque< action_queue_type::value_type >& _actions )
+{
+    size_t const max_items = ( _actions.size() < max_batch_updates ) ? ( max_batch_updates - _actions.size() ) : 0;
+    action_queue_ptr->popAll( [this, &_actions]( action_queue_type::value_type&& _item ){
+        _actions.emplace_back( resolveOverflow( std::move( _item ) ) );
+    }, max_items );
+}
+
+Context::action_queue_type::value_type Context::resolveOverflow( action_queue_type::value_type&& _item )
+{
+    auto const marker = boost::get< OverflowAction >( &std::get<0>( _item ) );
+    if( !marker )
+    {
+        return std::move( _item );
+    }
+
+    std::lock_guard< std::mutex > lock( overflow_mutex );
+    auto const overflow_it = overflow_actions.find( marker->target_id );
+    if( overflow_it == std::end( overflow_actions ) )
+    {
+        return std::move( _item );
+    }
+
+    auto const overflowed = std::move( overflow_it->second );
+    overflow_actions.erase( overflow_it );
+    return std::move( *overflowed );
+}
+
+bool Context::isQueueFull() const
+{
+    return max_queued_actions <= static_cast< size_t >( action_queue_ptr->size() );
+}
+
+// Blocks until an action arrives or the earliest held action is due. Returns false on the latter.
+bool Context::waitForAction() const
+{
+    if( held_actions.empty() )
+    {
+        action_queue_ptr->front();
+        return true;
+    }
+
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    for( auto const& id_action : held_actions )
+    {
+        deadline = std::min( deadline, next_publish_times.at( std::get<0>( id_action ) ) );
+    }
+    return action_queue_ptr->waitUntil( deadline );
+}
+
+void Context::dispatchAction( action_queue_type::value_type&& _item )
+{
+    auto& action = std::get<0>( _item );
+    auto const target_id = getTargetId( action );
+    auto const now = std::chrono::steady_clock::now();
+
+    auto const fence_action = boost::get< FenceAction >( &action );
+    if( fence_action )
+    {
+        // Held values go out later, so the fence has to wait for them as well.
+        auto const& fence = fence_action->payload.fence;
+        for( auto const& id_action : held_actions )
+        {
+            held_fences[ std::get<0>( id_action ) ].emplace_back( fence );
+        }
+        outbox.emplace_back( boost::none, update_job_array_type{}, fence_array_type{ fence } );
+        return;
+    }
+
+    if( boost::get< DeleteElementImplAction >( &action ) )
+    {
+        discardElementState( target_id );
+        processAction( action, std::get<1>( _item ) );
+        return;
+    }
+
+    // A frame request is about the version the client has, so a held value stays held.
+    if( boost::get< FrameRequestAction >( &action ) )
+    {
+        processAction( action, std::get<1>( _item ) );
+        return;
+    }
+
+    if( !boost::apply_visitor( IsSetValueActionVisitor{}, action ) )
+    {
+        // Anything else touching a held element has to observe the held value first.
+        auto const held_it = held_actions.find( target_id );
+        if( held_it != std::end( held_actions ) )
+        {
+            auto const held = std::move( held_it->second );
+            held_actions.erase( held_it );
+            processAction( std::get<0>( *held ), std::get<1>( *held ) );
+            releaseHeldFences( target_id );
+        }
+        processAction( action, std::get<1>( _item ) );
+        return;
+    }
+
+    double const max_publish_rate = getMaxPublishRate( target_id );
+    if( 0.0 < max_publish_rate )
+    {
+        auto& next_publish_time = next_publish_times[ target_id ];
+        if( now < next_publish_time )
+        {
+            held_actions[ target_id ] = std::make_unique< action_queue_type::value_type >( std::move( _item ) );
+            return;
+        }
+
+        auto const period = std::chrono::duration< double >( 1.0 / max_publish_rate );
+        next_publish_time = now + std::chrono::duration_cast< std::chrono::steady_clock::duration >( period );
+    }
+
+    held_actions.erase( target_id );
+    processAction( action, std::get<1>( _item ) );
+    releaseHeldFences( target_id );
+}
+
+void Context::publishHeldActions()
+{
+    auto const now = std::chrono::steady_clock::now();
+    for( auto held_it = std::begin( held_actions ); held_it != std::end( held_actions ); )
+    {
+        auto const target_id = std::get<0>( *held_it );
+        auto& next_publish_time = next_publish_times.at( target_id );
+        if( now < next_publish_time )
+        {
+            ++held_it;
+            continue;
+        }
+
+        double const max_publish_rate = getMaxPublishRate( target_id );
+        if( 0.0 < max_publish_rate )
+        {
+            auto const period = std::chrono::duration< double >( 1.0 / max_publish_rate );
+            next_publish_time = now + std::chrono::duration_cast< std::chrono::steady_clock::duration >( period );
+        }
+
+        auto const held = std::move( held_it->second );
+        held_it = held_actions.erase( held_it );
+        processAction( std::get<0>( *held ), std::get<1>( *held ) );
+        releaseHeldFences( target_id );
+    }
+}
+
+// Drops what is pending for a deleted element. Its fences move on as if its updates had been sent.
+void Context::discardElementState( element_id_type const _target_id )
+{
+    held_actions.erase( _target_id );
+    next_publish_times.erase( _target_id );
+    releaseHeldFences( _target_id );
+
+    std::lock_guard< std::mutex > lock( overflow_mutex );
+    overflow_actions.erase( _target_id );
+}
+
+void Context::releaseHeldFences( element_id_type const _target_id )
+{
+    auto const fences_it = held_fences.find( _target_id );
+    if( fences_it == std::end( held_fences ) )
+    {
+        return;
+    }
+
+    outbox.emplace_back( boost::none, update_job_array_type{}, std::move( fences_it->second ) );
+    held_fences.erase( fences_it );
+}
+
+void Context::processAction( ActionVariant& _action, bool const _is_sync_with_client )
 {
+    try
+    {
+        auto const receiver = boost::apply_visitor( SyncReceiverVisitor{}, _action );
+        auto updates = boost::apply_visitor( ActionVisitor{}, _action );
+        if( _is_sync_with_client )
+        {
+            outbox.emplace_back( receiver, std::move( updates ), fence_array_type{} );
+        }
+    }
+    catch( std::exception& e )
+    {
+        LOG(error) << e.what();
+        //TODO: show error modal
+    }
 }
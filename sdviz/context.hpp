@@ -2,20 +2,39 @@
 # define __SDVIZ_CONTEXT_HPP__
 
 # include <memory>
+# include <string>
 # include <thread>
 # include <atomic>
+# include <chrono>
+# include <condition_variable>
+# include <deque>
+# include <mutex>
 # include <tuple>
+# include <unordered_map>
+# include <vector>
+
+# include <boost/optional.hpp>
 
 # include "action.hpp"
+# include "fence.hpp"
 # include "mpsc_queue.hpp"
+# include "serdes.hpp"
+# include "sdviz.hpp"
 
 namespace sdviz
 {
 
+    struct ActionLanePolicy
+    {
+        static constexpr size_t lanes = LaneCount;
+
+        size_t operator()( std::tuple< ActionVariant, bool > const& _item ) const;
+    };
+
     class Context final
     {
         public:
-            using action_queue_type = MPSCQueue< std::tuple< ActionVariant, bool > >;
+            using action_queue_type = MPSCQueue< std::tuple< ActionVariant, bool >, ActionLanePolicy >;
 
             Context( Context const& _context ) = delete;
             Context( Context&& _context ) = delete;
@@ -25,17 +44,46 @@ namespace sdviz
             Context& operator=( Context&& _context ) = delete;
 
             static Context& getInstance();
-            void start();
+            void start( Config const& _config );
             void wait();
             void stop();
             std::shared_ptr< action_queue_type> getQueuePtr() const;
+            bool pushAction( ActionVariant&& _action, bool const _is_sync_with_client = true );
+            void pushFence( fence_ptr_type const& _fence );
 
         private:
             Context();
+            void popActions( std::deque< action_queue_type::value_type >& _actions );
+            action_queue_type::value_type resolveOverflow( action_queue_type::value_type&& _item );
+            bool isQueueFull() const;
+            bool waitForAction() const;
+            void dispatchAction( action_queue_type::value_type&& _item );
+            void publishHeldActions();
+            void releaseHeldFences( element_id_type const _target_id );
+            void discardElementState( element_id_type const _target_id );
+            void processAction( ActionVariant& _action, bool const _is_sync_with_client );
+            void publishUpdates();
 
             std::shared_ptr< action_queue_type > action_queue_ptr;
             std::thread loop_thread;
             std::atomic< bool > is_loop;
+            std::chrono::milliseconds coalescing_interval;
+            std::chrono::milliseconds batch_latency;
+            size_t max_batch_updates;
+            size_t max_queued_actions;
+            Config::OverflowPolicy overflow_policy;
+            // Set-value actions which did not fit into the queue, latest one per element.
+            std::unordered_map< element_id_type, std::unique_ptr< action_queue_type::value_type > > overflow_actions;
+            std::mutex overflow_mutex;
+            std::condition_variable overflow_cond;
+            // Updates produced by the current batch of actions along with their receiver, none for broadcast,
+            // and the fences following them.
+            std::vector< std::tuple< boost::optional< std::string >, update_job_array_type, fence_array_type > > outbox;
+            // Set-value actions held back by the per-element publish rate, latest one per element.
+            std::unordered_map< element_id_type, std::unique_ptr< action_queue_type::value_type > > held_actions;
+            std::unordered_map< element_id_type, std::chrono::steady_clock::time_point > next_publish_times;
+            // Fences issued while an element had a held action, released once that action is published.
+            std::unordered_map< element_id_type, fence_array_type > held_fences;
     };
 }
 
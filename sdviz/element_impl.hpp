@@ -3,6 +3,8 @@
 
 # include <string>
 # include <map>
+# include <memory>
+# include <mutex>
 # include <vector>
 
 # include <boost/variant.hpp>
@@ -12,6 +14,41 @@
 
 namespace sdviz
 {
+    class SerializedUpdate;
+
+    // The serialized update of an element at its latest version, shared by the element and its
+    // snapshots. Whichever thread encodes that version first fills it in for the others.
+    class EncodedElementCache final
+    {
+        public:
+            std::shared_ptr< SerializedUpdate const > get( int const _version ) const
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                return ( _version == version ) ? update : nullptr;
+            }
+
+            void set( int const _version, std::shared_ptr< SerializedUpdate const > const& _update )
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                if( _version == version )
+                {
+                    update = _update;
+                }
+            }
+
+            void invalidate( int const _version )
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                version = _version;
+                update = nullptr;
+            }
+
+        private:
+            mutable std::mutex mutex;
+            int version = 0;
+            std::shared_ptr< SerializedUpdate const > update;
+    };
+
     template< typename ValueType, typename ParamType >
     class ElementImpl final
     {
@@ -21,39 +58,55 @@ namespace sdviz
 
             ElementImpl() = delete;
             ElementImpl( value_type&& _value, param_type const& _param )
-                : value( std::forward< value_type >( _value ) ),
-                  param( _param ),
-                  version( 0 )
+                : value( std::make_shared< value_type const >( std::forward< value_type >( _value ) ) ),
+                  param( std::make_shared< param_type const >( _param ) ),
+                  version( 0 ),
+                  value_version( 0 ),
+                  param_version( 0 ),
+                  cache( std::make_shared< EncodedElementCache >() )
             {
             }
 
-            ElementImpl( ElementImpl const& _element ) = delete;
             ElementImpl( ElementImpl&& _element ) = default;
             ~ElementImpl() = default;
 
             ElementImpl& operator =( ElementImpl const& _element ) = delete;
             ElementImpl& operator =( ElementImpl&& _element ) = default;
 
+            // Value and param are immutable once set and shared with snapshots, so a snapshot
+            // can be read on another thread while the element moves on.
+            ElementImpl snapshot() const
+            {
+                return ElementImpl( *this );
+            }
+
             value_type const& getValue() const
+            {
+                return *value;
+            }
+
+            std::shared_ptr< value_type const > const& getValuePtr() const
             {
                 return value;
             }
 
             void setValue( value_type&& _value )
             {
-                value = std::forward< value_type >( _value );
-                version++;
+                value = std::make_shared< value_type const >( std::forward< value_type >( _value ) );
+                value_version = ++version;
+                cache->invalidate( version );
             }
 
             param_type const& getParam() const
             {
-                return param;
+                return *param;
             }
 
             void setParam( param_type&& _param )
             {
-                param = std::forward< param_type >( _param );
-                version++;
+                param = std::make_shared< param_type const >( std::forward< param_type >( _param ) );
+                param_version = ++version;
+                cache->invalidate( version );
             }
 
             int getVersion() const
@@ -61,21 +114,43 @@ namespace sdviz
                 return version;
             }
 
+            int getValueVersion() const
+            {
+                return value_version;
+            }
+
+            int getParamVersion() const
+            {
+                return param_version;
+            }
+
+            EncodedElementCache& getEncodedCache() const
+            {
+                return *cache;
+            }
+
         private:
-            value_type value;
-            param_type param;
+            ElementImpl( ElementImpl const& _element ) = default;
+
+            std::shared_ptr< value_type const > value;
+            std::shared_ptr< param_type const > param;
             int version;
+            int value_version;
+            int param_version;
+            std::shared_ptr< EncodedElementCache > cache;
     };
 
     struct ButtonElementImplParam
     {
         std::string label;
         std::function< void( bool, bool ) > on_value_changed;
+        bool coalesce_inbound;
     };
     using ButtonElementImpl = ElementImpl< bool, ButtonElementImplParam >;
 
     struct CanvasElementImplParam
     {
+        double max_publish_rate = 0.0;
     };
     using CanvasElementImpl = ElementImpl< CanvasImpl, CanvasElementImplParam >;
 
@@ -83,6 +158,7 @@ namespace sdviz
     {
         std::string type;
         std::map< std::string, std::string > value_map;
+        double max_publish_rate = 0.0;
     };
     using ChartElementImpl = ElementImpl< std::map< std::string, std::vector< double > >, ChartElementImplParam >;
 
@@ -97,6 +173,7 @@ namespace sdviz
     {
         std::string label;
         std::function< void( double, double ) > on_value_changed;
+        bool coalesce_inbound;
     };
     using SliderElementImpl = ElementImpl< double, SliderElementImplParam >;
 
@@ -113,6 +190,19 @@ namespace sdviz
         ButtonElementImpl,
         SliderElementImpl
     >;
+
+    // Priority classes of queued work, highest first. Canvas and chart values are bulky,
+    // the other elements are small interactive controls which must not wait behind them.
+    enum Lane
+    {
+        ControlLane,
+        BulkLane,
+        LaneCount
+    };
+
+    template< typename ElementImplType > struct ElementLane { static constexpr Lane value = ControlLane; };
+    template<> struct ElementLane< CanvasElementImpl > { static constexpr Lane value = BulkLane; };
+    template<> struct ElementLane< ChartElementImpl > { static constexpr Lane value = BulkLane; };
 }
 
 #endif //__SDVIZ_ELEMENT_IMPL_HPP__
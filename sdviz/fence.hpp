@@ -0,0 +1,40 @@
+#ifndef __SDVIZ_FENCE_HPP__
+# define __SDVIZ_FENCE_HPP__
+
+# include <future>
+# include <memory>
+# include <vector>
+
+namespace sdviz
+{
+    // Completes its future when the last reference to it goes away. Whatever is still pending
+    // when a fence is issued holds on to it until it has been sent or dropped, so the fence
+    // completes once everything issued before it is done.
+    class Fence final
+    {
+        public:
+            Fence() = default;
+            Fence( Fence const& ) = delete;
+            Fence( Fence&& ) = delete;
+            ~Fence()
+            {
+                promise.set_value();
+            }
+
+            Fence& operator =( Fence const& ) = delete;
+            Fence& operator =( Fence&& ) = delete;
+
+            std::future< void > getFuture()
+            {
+                return promise.get_future();
+            }
+
+        private:
+            std::promise< void > promise;
+    };
+
+    using fence_ptr_type = std::shared_ptr< Fence >;
+    using fence_array_type = std::vector< fence_ptr_type >;
+}
+
+#endif // __SDVIZ_FENCE_HPP__
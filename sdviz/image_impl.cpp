@@ -1,4 +1,6 @@
 #include "image_impl.hpp"
+#include "image_pyramid.hpp"
+#include "pixel_convert.hpp"
 
 #include <cstdlib>
 #include <stdexcept>
@@ -13,9 +15,15 @@ namespace
         switch( _format )
         {
             case ImageImpl::Format::RGB_888:
+            case ImageImpl::Format::BGR_888: // fall through
                 return 3;
+            case ImageImpl::Format::BGRA_8888:
+            case ImageImpl::Format::RGBA_8888: // fall through
+                return 4;
             case ImageImpl::Format::UINT_8:
             case ImageImpl::Format::UINT_16: // fall through
+            case ImageImpl::Format::INT_16: // fall through
+            case ImageImpl::Format::FLOAT_32: // fall through
                 return 1;
         }
 
@@ -28,46 +36,166 @@ namespace
         {
             case ImageImpl::Format::RGB_888:
             case ImageImpl::Format::UINT_8: // fall through
+            case ImageImpl::Format::BGR_888: // fall through
+            case ImageImpl::Format::BGRA_8888: // fall through
+            case ImageImpl::Format::RGBA_8888: // fall through
                 return 1;
             case ImageImpl::Format::UINT_16:
+            case ImageImpl::Format::INT_16: // fall through
                 return 2;
+            case ImageImpl::Format::FLOAT_32:
+                return 4;
         }
 
         throw std::runtime_error( "Invalid image format." );
     }
 
+    size_t GetRowSize( int const _width, ImageImpl::Format const _format )
+    {
+        return _width * GetChannelsPerPixel( _format ) * GetBytesPerChannel( _format );
+    }
+
     size_t GetBufferSize( int const _width, int const _height, ImageImpl::Format const _format )
     {
-        return _width * _height * GetChannelsPerPixel( _format ) * GetBytesPerChannel( _format );
+        return _height * GetRowSize( _width, _format );
+    }
+
+    size_t GetStride( int const _width, ImageImpl::Format const _format, size_t const _stride )
+    {
+        size_t const row_size = GetRowSize( _width, _format );
+        if( ( _stride != 0 ) && ( _stride < row_size ) )
+        {
+            throw std::runtime_error( "Image stride is smaller than a row." );
+        }
+
+        return ( _stride == 0 ) ? row_size : _stride;
+    }
+
+    std::shared_ptr< uint8_t > AllocateBuffer( size_t const _size )
+    {
+        return std::shared_ptr< uint8_t >( new uint8_t[_size], std::default_delete< uint8_t[] >() );
     }
 }
 
-sdviz::ImageImpl:: ImageImpl( int const _width, int const _height, Format const _format, uint8_t* const _buffer )
+sdviz::ImageImpl:: ImageImpl( int const _width, int const _height, Format const _format, uint8_t* const _buffer, size_t const _stride )
     : width( _width ),
       height( _height ),
       format( _format ),
-      buffer( ( _buffer == nullptr ) ? std::shared_ptr< uint8_t >( new uint8_t[::GetBufferSize( _width, _height, _format )] )
-                                     : std::shared_ptr< uint8_t >( _buffer, [](auto*){} ) )
+      stride( ::GetStride( _width, _format, _stride ) ),
+      offset( 0 ),
+      buffer( ( _buffer == nullptr ) ? AllocateBuffer( _height * stride )
+                                     : std::shared_ptr< uint8_t >( _buffer, [](auto*){} ) ),
+      is_frozen( false ),
+      is_borrowed( _buffer != nullptr ),
+      is_tiled( false )
 {
 }
 
-sdviz::ImageImpl::ImageImpl( int const _width, int const _height, Format const _format, std::shared_ptr< uint8_t > const _buffer )
+sdviz::ImageImpl::ImageImpl( int const _width, int const _height, Format const _format, std::shared_ptr< uint8_t > const _buffer, size_t const _stride )
     : width( _width ),
       height( _height ),
       format( _format ),
-      buffer( ( _buffer.get() == nullptr ) ? std::shared_ptr< uint8_t >( new uint8_t[::GetBufferSize( _width, _height, _format )] )
-                                           : std::shared_ptr< uint8_t >( _buffer ) )
+      stride( ::GetStride( _width, _format, _stride ) ),
+      offset( 0 ),
+      buffer( ( _buffer.get() == nullptr ) ? AllocateBuffer( _height * stride )
+                                           : std::shared_ptr< uint8_t >( _buffer ) ),
+      is_frozen( false ),
+      is_borrowed( false ),
+      is_tiled( false )
 {
 }
 
 sdviz::ImageImpl sdviz::ImageImpl::clone() const
 {
     ImageImpl new_image_impl( width, height, format );
-    size_t buffer_size = GetBufferSize( new_image_impl );
-    std::copy( buffer.get(), buffer.get() + buffer_size, new_image_impl.buffer.get() );
+    if( pyramid )
+    {
+        new_image_impl.enablePyramid();
+        new_image_impl.is_tiled = is_tiled;
+    }
+
+    size_t const row_size = GetRowSize( *this );
+    if( isPacked() )
+    {
+        std::copy( getBuffer(), getBuffer() + height * row_size, new_image_impl.getBuffer() );
+        return new_image_impl;
+    }
+
+    for( int row = 0; row < height; ++row )
+    {
+        uint8_t const* const src_row = getBuffer() + row * stride;
+        std::copy( src_row, src_row + row_size, new_image_impl.getBuffer() + row * row_size );
+    }
     return new_image_impl;
 }
 
+// A view of the rectangle sharing the pixels of this image.
+sdviz::ImageImpl sdviz::ImageImpl::getRegion( int const _x, int const _y, int const _width, int const _height ) const
+{
+    if( ( _x < 0 ) || ( _y < 0 ) || ( _width < 0 ) || ( _height < 0 ) || ( width < _x + _width ) || ( height < _y + _height ) )
+    {
+        throw std::runtime_error( "Image region is out of bounds." );
+    }
+
+    ImageImpl region{ *this };
+    region.width = _width;
+    region.height = _height;
+    region.offset = offset + _y * stride + _x * ::GetChannelsPerPixel( format ) * ::GetBytesPerChannel( format );
+    if( pyramid )
+    {
+        region.enablePyramid();
+    }
+    return region;
+}
+
+// Starts a pyramid with no levels built yet, so it also drops the levels of earlier pixels.
+void sdviz::ImageImpl::enablePyramid()
+{
+    pyramid = std::make_shared< ImagePyramid >();
+}
+
+void sdviz::ImageImpl::enableTiling()
+{
+    enablePyramid();
+    is_tiled = true;
+}
+
+bool sdviz::ImageImpl::isTiled() const noexcept
+{
+    return is_tiled;
+}
+
+int sdviz::ImageImpl::getLevelCount() const
+{
+    return pyramid ? ImagePyramid::GetLevelCount( width, height ) : 1;
+}
+
+// Levels and tiles are normalized over the range of the whole image, which the pyramid keeps.
+ImageImpl::value_range_type sdviz::ImageImpl::getValueRange() const
+{
+    return pyramid ? pyramid->getValueRange( *this ) : PixelConverter::GetValueRange( *this );
+}
+
+ImageImpl sdviz::ImageImpl::getLevel( int const _level ) const
+{
+    return pyramid ? pyramid->getLevel( *this, std::min( _level, getLevelCount() - 1 ) ) : *this;
+}
+
+void sdviz::ImageImpl::freeze() noexcept
+{
+    is_frozen = true;
+}
+
+bool sdviz::ImageImpl::isFrozen() const noexcept
+{
+    return is_frozen;
+}
+
+bool sdviz::ImageImpl::isBorrowed() const noexcept
+{
+    return is_borrowed;
+}
+
 int sdviz::ImageImpl::getWidth() const noexcept
 {
     return width;
@@ -83,9 +211,74 @@ sdviz::ImageImpl::Format sdviz::ImageImpl::getFormat() const noexcept
     return format;
 }
 
+size_t sdviz::ImageImpl::getStride() const noexcept
+{
+    return stride;
+}
+
+bool sdviz::ImageImpl::isPacked() const noexcept
+{
+    return stride == GetRowSize( *this );
+}
+
 uint8_t* sdviz::ImageImpl::getBuffer() const noexcept
 {
-    return buffer.get();
+    return buffer.get() + offset;
+}
+
+// Copy on write: a frozen buffer still referenced elsewhere is copied before it is handed out,
+// the image is writable again afterwards.
+uint8_t* sdviz::ImageImpl::getMutableBuffer()
+{
+    if( is_frozen )
+    {
+        if( buffer.use_count() > 1 )
+        {
+            *this = clone();
+        }
+        else if( pyramid )
+        {
+            enablePyramid();
+        }
+        is_frozen = false;
+    }
+
+    return getBuffer();
+}
+
+bool sdviz::ImageImpl::operator ==( ImageImpl const& _image_impl ) const
+{
+    if( ( width != _image_impl.width ) || ( height != _image_impl.height ) || ( format != _image_impl.format ) )
+    {
+        return false;
+    }
+
+    if( sharesPixelsWith( _image_impl ) )
+    {
+        return true;
+    }
+
+    size_t const row_size = GetRowSize( *this );
+    for( int row = 0; row < height; ++row )
+    {
+        uint8_t const* const row_begin = getBuffer() + row * stride;
+        if( !std::equal( row_begin, row_begin + row_size, _image_impl.getBuffer() + row * _image_impl.stride ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool sdviz::ImageImpl::sharesPixelsWith( ImageImpl const& _image_impl ) const noexcept
+{
+    return ( buffer == _image_impl.buffer )
+           && ( offset == _image_impl.offset )
+           && ( stride == _image_impl.stride )
+           && ( width == _image_impl.width )
+           && ( height == _image_impl.height )
+           && ( format == _image_impl.format );
 }
 
 int sdviz::ImageImpl::GetChannelsPerPixel( ImageImpl const& _image_impl )
@@ -102,3 +295,8 @@ size_t sdviz::ImageImpl::GetBufferSize( ImageImpl const& _image_impl )
 {
     return ::GetBufferSize( _image_impl.width, _image_impl.height, _image_impl.format );
 }
+
+size_t sdviz::ImageImpl::GetRowSize( ImageImpl const& _image_impl )
+{
+    return ::GetRowSize( _image_impl.width, _image_impl.format );
+}
@@ -2,43 +2,85 @@
 # define __SDVIZ_IMAGE_IMPL_HPP__
 
 #include <memory>
+#include <utility>
 
 namespace sdviz
 {
+    class ImagePyramid;
+
     class ImageImpl final
     {
         public:
+            // The values are sent to the client as is.
             enum Format
             {
                 RGB_888,
                 UINT_8,
-                UINT_16
+                UINT_16,
+                BGR_888,
+                BGRA_8888,
+                RGBA_8888,
+                INT_16,
+                FLOAT_32
             };
 
             static int GetChannelsPerPixel( ImageImpl const& _image_impl );
             static size_t GetBytesPerChannel( ImageImpl const& _image_impl );
             static size_t GetBufferSize( ImageImpl const& _image_impl );
+            static size_t GetRowSize( ImageImpl const& _image_impl );
+
+            // Smallest and largest value of a FLOAT_32 image, NaNs aside.
+            using value_range_type = std::pair< float, float >;
 
-            ImageImpl( int const _width, int const _height, Format const _format, uint8_t* const _buffer = nullptr );
-            ImageImpl( int const _width, int const _height, Format const _format, std::shared_ptr< uint8_t > const _buffer );
+            // A zero stride means tightly packed rows.
+            ImageImpl( int const _width, int const _height, Format const _format, uint8_t* const _buffer = nullptr, size_t const _stride = 0 );
+            ImageImpl( int const _width, int const _height, Format const _format, std::shared_ptr< uint8_t > const _buffer, size_t const _stride = 0 );
             ImageImpl( ImageImpl const& _image_impl ) = default;
             ImageImpl( ImageImpl&& _image_impl ) = default;
             ~ImageImpl() = default;
 
             ImageImpl clone() const;
+            ImageImpl getRegion( int const _x, int const _y, int const _width, int const _height ) const;
+            void enablePyramid();
+            void enableTiling();
+            bool isTiled() const noexcept;
+            int getLevelCount() const;
+            ImageImpl getLevel( int const _level ) const;
+            value_range_type getValueRange() const;
+            void freeze() noexcept;
+            bool isFrozen() const noexcept;
+            // Whether the pixels live in a raw buffer of the caller, which may be reused or freed
+            // once the image is dropped.
+            bool isBorrowed() const noexcept;
             int getWidth() const noexcept;
             int getHeight() const noexcept;
             Format getFormat() const noexcept;
+            size_t getStride() const noexcept;
+            bool isPacked() const noexcept;
             uint8_t* getBuffer() const noexcept;
+            uint8_t* getMutableBuffer();
 
             ImageImpl& operator =( ImageImpl const& _image_impl ) = default;
             ImageImpl& operator =( ImageImpl&& _image_impl ) = default;
+            bool operator ==( ImageImpl const& _image_impl ) const;
+            // Whether both show the same pixels of the same buffer, without looking at them.
+            bool sharesPixelsWith( ImageImpl const& _image_impl ) const noexcept;
 
         private:
             int width;
             int height;
             Format format;
+            // Bytes from one row to the next, and from the start of the buffer to the first pixel.
+            size_t stride;
+            size_t offset;
             std::shared_ptr< uint8_t > buffer;
+            // The pixels may be shared with canvases and must not be written in place.
+            bool is_frozen;
+            bool is_borrowed;
+            // Shared by the copies sharing the pixels, null unless the pyramid is enabled.
+            std::shared_ptr< ImagePyramid > pyramid;
+            // The levels of the pyramid are sent tile by tile, as far as clients see them.
+            bool is_tiled;
     };
 }
 
@@ -0,0 +1,225 @@
+#include "./image_pyramid.hpp"
+#include "./pixel_convert.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+using namespace sdviz;
+
+namespace
+{
+    // Rounds half up, like the SSE2 averaging instructions.
+    template< typename T >
+    T averagePair( T const _a, T const _b )
+    {
+        return static_cast< T >( ( _a + _b + 1 ) >> 1 );
+    }
+
+    template<>
+    float averagePair< float >( float const _a, float const _b )
+    {
+        return ( _a + _b ) * 0.5f;
+    }
+
+    template< typename T >
+    void averageRows( T const* const _upper, T const* const _lower, T* const _dst, size_t const _count )
+    {
+        for( size_t i = 0; i < _count; ++i )
+        {
+            _dst[ i ] = averagePair( _upper[ i ], _lower[ i ] );
+        }
+    }
+
+#ifdef __SSE2__
+    template<>
+    void averageRows< uint8_t >( uint8_t const* const _upper, uint8_t const* const _lower, uint8_t* const _dst, size_t const _count )
+    {
+        size_t i = 0;
+        for( ; i + 16 <= _count; i += 16 )
+        {
+            __m128i const upper = _mm_loadu_si128( reinterpret_cast< __m128i const* >( _upper + i ) );
+            __m128i const lower = _mm_loadu_si128( reinterpret_cast< __m128i const* >( _lower + i ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( _dst + i ), _mm_avg_epu8( upper, lower ) );
+        }
+        for( ; i < _count; ++i )
+        {
+            _dst[ i ] = averagePair( _upper[ i ], _lower[ i ] );
+        }
+    }
+
+    template<>
+    void averageRows< uint16_t >( uint16_t const* const _upper, uint16_t const* const _lower, uint16_t* const _dst, size_t const _count )
+    {
+        size_t i = 0;
+        for( ; i + 8 <= _count; i += 8 )
+        {
+            __m128i const upper = _mm_loadu_si128( reinterpret_cast< __m128i const* >( _upper + i ) );
+            __m128i const lower = _mm_loadu_si128( reinterpret_cast< __m128i const* >( _lower + i ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( _dst + i ), _mm_avg_epu16( upper, lower ) );
+        }
+        for( ; i < _count; ++i )
+        {
+            _dst[ i ] = averagePair( _upper[ i ], _lower[ i ] );
+        }
+    }
+
+    // Flipping the sign bit maps signed values onto unsigned ones in the same order.
+    template<>
+    void averageRows< int16_t >( int16_t const* const _upper, int16_t const* const _lower, int16_t* const _dst, size_t const _count )
+    {
+        size_t i = 0;
+        __m128i const sign_bit = _mm_set1_epi16( static_cast< short >( 0x8000 ) );
+        for( ; i + 8 <= _count; i += 8 )
+        {
+            __m128i const upper = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast< __m128i const* >( _upper + i ) ), sign_bit );
+            __m128i const lower = _mm_xor_si128( _mm_loadu_si128( reinterpret_cast< __m128i const* >( _lower + i ) ), sign_bit );
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( _dst + i ), _mm_xor_si128( _mm_avg_epu16( upper, lower ), sign_bit ) );
+        }
+        for( ; i < _count; ++i )
+        {
+            _dst[ i ] = averagePair( _upper[ i ], _lower[ i ] );
+        }
+    }
+
+    template<>
+    void averageRows< float >( float const* const _upper, float const* const _lower, float* const _dst, size_t const _count )
+    {
+        size_t i = 0;
+        __m128 const half = _mm_set1_ps( 0.5f );
+        for( ; i + 4 <= _count; i += 4 )
+        {
+            __m128 const sum = _mm_add_ps( _mm_loadu_ps( _upper + i ), _mm_loadu_ps( _lower + i ) );
+            _mm_storeu_ps( _dst + i, _mm_mul_ps( sum, half ) );
+        }
+        for( ; i < _count; ++i )
+        {
+            _dst[ i ] = averagePair( _upper[ i ], _lower[ i ] );
+        }
+    }
+#endif
+
+    // Averages horizontal pixel pairs. The last column of an odd width is left out, as the
+    // halved width rounds down, and a single column is averaged with itself.
+    template< typename T >
+    void halveRow( T const* const _src, T* const _dst, int const _src_width, int const _dst_width, int const _channels )
+    {
+        for( int x = 0; x < _dst_width; ++x )
+        {
+            T const* const left = _src + 2 * x * _channels;
+            T const* const right = _src + std::min( 2 * x + 1, _src_width - 1 ) * _channels;
+            for( int channel = 0; channel < _channels; ++channel )
+            {
+                _dst[ x * _channels + channel ] = averagePair( left[ channel ], right[ channel ] );
+            }
+        }
+    }
+
+    // Each pixel becomes the mean of a 2x2 block, the rows being averaged first. An odd last row
+    // is left out like an odd last column, a single row is averaged with itself.
+    template< typename T >
+    ImageImpl downsample( ImageImpl const& _src )
+    {
+        int const src_width = _src.getWidth();
+        int const src_height = _src.getHeight();
+        int const width = std::max( src_width / 2, 1 );
+        int const height = std::max( src_height / 2, 1 );
+        int const channels = ImageImpl::GetChannelsPerPixel( _src );
+
+        ImageImpl dst( width, height, _src.getFormat() );
+        std::vector< T > averaged_row( src_width * channels );
+        for( int y = 0; y < height; ++y )
+        {
+            auto const upper = reinterpret_cast< T const* >( _src.getBuffer() + ( 2 * y ) * _src.getStride() );
+            auto const lower = reinterpret_cast< T const* >( _src.getBuffer() + std::min( 2 * y + 1, src_height - 1 ) * _src.getStride() );
+            averageRows( upper, lower, averaged_row.data(), averaged_row.size() );
+            halveRow( averaged_row.data(), reinterpret_cast< T* >( dst.getBuffer() + y * dst.getStride() ), src_width, width, channels );
+        }
+
+        return dst;
+    }
+
+    ImageImpl downsample( ImageImpl const& _src )
+    {
+        switch( _src.getFormat() )
+        {
+            case ImageImpl::Format::RGB_888:
+            case ImageImpl::Format::UINT_8: // fall through
+            case ImageImpl::Format::BGR_888: // fall through
+            case ImageImpl::Format::BGRA_8888: // fall through
+            case ImageImpl::Format::RGBA_8888: // fall through
+                return downsample< uint8_t >( _src );
+            case ImageImpl::Format::UINT_16:
+                return downsample< uint16_t >( _src );
+            case ImageImpl::Format::INT_16:
+                return downsample< int16_t >( _src );
+            case ImageImpl::Format::FLOAT_32:
+                return downsample< float >( _src );
+        }
+
+        throw std::runtime_error( "Invalid image format." );
+    }
+}
+
+// Bound to references by std::min and the intermediate map, so they need a definition before C++17.
+constexpr int sdviz::ImagePyramid::min_level_size;
+constexpr int sdviz::ImagePyramid::tile_size;
+
+int sdviz::ImagePyramid::GetLevelCount( int const _width, int const _height )
+{
+    int count = 1;
+    for( int width = _width, height = _height; ( min_level_size < std::max( width, height ) ) && ( 1 < width ) && ( 1 < height ); width /= 2, height /= 2 )
+    {
+        ++count;
+    }
+
+    return count;
+}
+
+// Matches the size downsample gives each level.
+int sdviz::ImagePyramid::GetLevelExtent( int const _extent, int const _level )
+{
+    int extent = _extent;
+    for( int level = 0; level < _level; ++level )
+    {
+        extent = std::max( extent / 2, 1 );
+    }
+
+    return extent;
+}
+
+int sdviz::ImagePyramid::GetTileCount( int const _extent, int const _level )
+{
+    return ( GetLevelExtent( _extent, _level ) + tile_size - 1 ) / tile_size;
+}
+
+ImageImpl sdviz::ImagePyramid::getLevel( ImageImpl const& _base, int const _level )
+{
+    if( _level <= 0 )
+    {
+        return _base;
+    }
+
+    std::lock_guard< std::mutex > lock( mutex );
+    while( levels.size() < static_cast< size_t >( _level ) )
+    {
+        levels.emplace_back( downsample( levels.empty() ? _base : levels.back() ) );
+    }
+
+    return levels[ _level - 1 ];
+}
+
+ImageImpl::value_range_type sdviz::ImagePyramid::getValueRange( ImageImpl const& _base )
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    if( !has_value_range )
+    {
+        value_range = PixelConverter::GetValueRange( _base );
+        has_value_range = true;
+    }
+
+    return value_range;
+}
@@ -0,0 +1,46 @@
+#ifndef __SDVIZ_IMAGE_PYRAMID_HPP__
+# define __SDVIZ_IMAGE_PYRAMID_HPP__
+
+# include <mutex>
+# include <vector>
+
+# include "./image_impl.hpp"
+
+namespace sdviz
+{
+    // Box filtered copies of an image, each level half the size of the one before, until the
+    // longer side fits min_level_size. Level 0 is the image itself. The levels are built on
+    // first use, by the encoder thread which needs them, and kept until the pixels change.
+    // A tiled pyramid is sent in tile_size squares, each level cut from its top left corner.
+    // The value range of the image is kept too, so every level and tile is normalized alike.
+    class ImagePyramid final
+    {
+        public:
+            static constexpr int min_level_size = 256;
+            static constexpr int tile_size = 256;
+
+            static int GetLevelCount( int const _width, int const _height );
+            static int GetLevelExtent( int const _extent, int const _level );
+            static int GetTileCount( int const _extent, int const _level );
+
+            ImagePyramid() = default;
+            ImagePyramid( ImagePyramid const& ) = delete;
+            ImagePyramid( ImagePyramid&& ) = delete;
+            ~ImagePyramid() = default;
+
+            ImagePyramid& operator =( ImagePyramid const& ) = delete;
+            ImagePyramid& operator =( ImagePyramid&& ) = delete;
+
+            ImageImpl getLevel( ImageImpl const& _base, int const _level );
+            ImageImpl::value_range_type getValueRange( ImageImpl const& _base );
+
+        private:
+            std::mutex mutex;
+            bool has_value_range = false;
+            ImageImpl::value_range_type value_range;
+            // Level i + 1 is levels[ i ].
+            std::vector< ImageImpl > levels;
+    };
+}
+
+#endif // __SDVIZ_IMAGE_PYRAMID_HPP__
@@ -1,13 +1,14 @@
 #ifndef __SDVIZ_LAYOUT_IMPL_HPP__
 # define __SDVIZ_LAYOUT_IMPL_HPP__
 
-# include <string>
 # include <tuple>
 # include <vector>
 
+# include "sdviz.hpp"
+
 namespace sdviz
 {
-    using LayoutImpl = std::vector< std::tuple< int, std::string > >;
+    using LayoutImpl = std::vector< std::tuple< int, element_id_type > >;
 }
 
 #endif //__SDVIZ_LAYOUT_IMPL_HPP__
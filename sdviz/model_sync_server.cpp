@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <iterator>
+
 #include <boost/lexical_cast.hpp>
 
 #include "action.hpp"
@@ -16,15 +19,18 @@ ModelSyncServer& ModelSyncServer::getInstance()
     return server;
 }
 
-void ModelSyncServer::start( int const _http_port,
-                             int const _http_threads,
-                             int const _ws_port,
-                             int const _ws_threads )
+void ModelSyncServer::start( Config const& _config )
 {
-    http_server_ptr = std::make_unique< HttpServer >( _http_port, _http_threads );
-    http_server_ptr->resource["^/config$"]["GET"]=[&,_ws_port]( std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> ) {
+    int const ws_port = _config.ws_port;
+    size_t const max_queued_frames = std::max( 1, _config.max_queued_frames );
+    size_t const max_queued_bytes = std::max( 1, _config.max_queued_bytes );
+    size_t const max_batch_updates = std::max( 1, _config.max_batch_updates );
+    size_t const max_batch_bytes = std::max( 1, _config.max_batch_bytes );
+
+    http_server_ptr = std::make_unique< HttpServer >( _config.http_port, _config.http_threads );
+    http_server_ptr->resource["^/config$"]["GET"]=[&,ws_port]( std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> ) {
         std::stringstream ss;
-        ss << "{" << R"("ws_port")" << ":" << _ws_port << "}";
+        ss << "{" << R"("ws_port")" << ":" << ws_port << "}";
         std::string const content{ss.str()};
 
         *response << "HTTP/1.1 200 OK\r\nContent-Length: " << content.size() << "\r\n\r\n" << content;
@@ -36,23 +42,28 @@ void ModelSyncServer::start( int const _http_port,
         response->flush();
     };
 
-    ws_server_ptr = std::make_unique< WsServer >( _ws_port, _ws_threads );
+    ws_server_ptr = std::make_unique< WsServer >( ws_port, _config.ws_threads );
     auto& ws_endpoint = ws_server_ptr->endpoint["^/$"];
-    ws_endpoint.onopen=[&]( std::shared_ptr<WsServer::Connection> connection) {
+    ws_endpoint.onopen=[&,max_queued_frames,max_queued_bytes,max_batch_updates,max_batch_bytes]( std::shared_ptr<WsServer::Connection> connection) {
         std::string const con_hash = hashConnection( connection );
         LOG(info) << "Server: Opened connection " << con_hash << ".";
+        {
+            auto session = std::make_shared< SyncSession >( max_queued_frames, max_queued_bytes, max_batch_updates, max_batch_bytes );
+            std::lock_guard< std::mutex > lock( sessions_mutex );
+            sessions[ con_hash ] = std::make_tuple( connection, session );
+        }
 
-        ActionVariant action{  SyncAction{ dummy_id, nullptr } };
+        ActionVariant action{  SyncAction{ dummy_id, SyncRequest{ con_hash, {} } } };
         auto queue_ptr = Context::getInstance().getQueuePtr();
         queue_ptr->push( std::make_tuple( std::move( action ), true ) );
     };
 
-    ws_endpoint.onmessage=[&]( std::shared_ptr<WsServer::Connection>, std::shared_ptr<WsServer::Message> message) {
+    ws_endpoint.onmessage=[&]( std::shared_ptr<WsServer::Connection> connection, std::shared_ptr<WsServer::Message> message) {
         try
         {
             std::string message_str{ message->string() };
             auto intermediate_action = deserialize( serialized_type( message_str.begin(), message_str.end() ) );
-            receiveAction( intermediate_action );
+            receiveAction( hashConnection( connection ), intermediate_action );
         }
         catch( std::exception& e )
         {
@@ -68,12 +79,18 @@ void ModelSyncServer::start( int const _http_port,
     ws_endpoint.onclose=[&]( std::shared_ptr<WsServer::Connection> connection, int, std::string const& ) {
         std::string const con_hash = hashConnection( connection );
         LOG(info) << "Server: Closed connection " << con_hash << ".";
+
+        std::lock_guard< std::mutex > lock( sessions_mutex );
+        sessions.erase( con_hash );
     };
 
     //See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
     ws_endpoint.onerror=[&]( std::shared_ptr<WsServer::Connection> connection, const boost::system::error_code& ec) {
         std::string const con_hash = hashConnection( connection );
         LOG(info) << "Server: Error in connection " << con_hash << ". " << "Error: " << ec << ", error message: " << ec.message();
+
+        std::lock_guard< std::mutex > lock( sessions_mutex );
+        sessions.erase( con_hash );
     };
 
     http_server_thread = std::thread([&](){
@@ -111,29 +128,91 @@ void ModelSyncServer::stop()
     }
 
     wait();
+
+    // Dropping the sessions releases the fences of writes that will never complete.
+    std::lock_guard< std::mutex > lock( sessions_mutex );
+    sessions.clear();
 }
 
-void ModelSyncServer::sendAction( intermediate_type const& _intermediate_action )
+void ModelSyncServer::sendAction( std::vector< SyncSession::update_ptr_type > const& _updates, fence_array_type const& _fences )
 {
-    if( !isValid( _intermediate_action ) )
+    std::vector< session_type > target_sessions;
     {
-        return;
+        std::lock_guard< std::mutex > lock( sessions_mutex );
+        std::transform( std::begin( sessions ),
+                        std::end( sessions ),
+                        std::back_inserter( target_sessions ),
+                        []( auto const& _id_session ){ return std::get<1>( _id_session ); } );
     }
-    serialized_type buffer{ serialize( _intermediate_action ) };
 
-    auto send_stream = std::make_shared<WsServer::SendStream>();
-    std::copy( std::begin(buffer), std::end(buffer), std::ostream_iterator<serialized_type::value_type>(*send_stream));
+    sendUpdates( _updates, _fences, target_sessions );
+}
 
-    auto& ws_endpoint = ws_server_ptr->endpoint["^/$"];
-    auto connections = ws_endpoint.get_connections();
-    for( auto& con : connections )
+void ModelSyncServer::sendAction( std::vector< SyncSession::update_ptr_type > const& _updates,
+                                  fence_array_type const& _fences,
+                                  std::string const& _connection_id )
+{
+    std::vector< session_type > target_sessions;
+    {
+        std::lock_guard< std::mutex > lock( sessions_mutex );
+        auto const session_it = sessions.find( _connection_id );
+        if( session_it != std::end( sessions ) )
+        {
+            target_sessions.emplace_back( session_it->second );
+        }
+    }
+
+    sendUpdates( _updates, _fences, target_sessions );
+}
+
+// Sessions hold on to the fences until everything queued before them has been written.
+void ModelSyncServer::sendUpdates( std::vector< SyncSession::update_ptr_type > const& _updates,
+                                   fence_array_type const& _fences,
+                                   std::vector< session_type > const& _sessions )
+{
+    for( auto const& connection_session : _sessions )
+    {
+        auto const& session = std::get<1>( connection_session );
+        for( auto const& serialized_update : _updates )
+        {
+            session->push( serialized_update );
+        }
+
+        for( auto const& fence : _fences )
+        {
+            session->pushFence( fence );
+        }
+
+        writeSession( std::get<0>( connection_session ), session );
+    }
+}
+
+void ModelSyncServer::writeSession( std::shared_ptr< WsServer::Connection > const& _connection,
+                                    std::shared_ptr< SyncSession > const& _session )
+{
+    auto const messages = _session->next();
+    if( messages.empty() )
     {
-        ws_server_ptr->send( con, send_stream, [](const boost::system::error_code& ec){
-            if(ec) {
-                LOG(error) << "Server: Error sending message. Error: " << ec << ", error message: " << ec.message();
-            }
-        }, 130);
+        auto stale_ids = _session->takeStaleIds();
+        if( !stale_ids.empty() )
+        {
+            ActionVariant action{ SyncAction{ dummy_id, SyncRequest{ hashConnection( _connection ), std::move( stale_ids ) } } };
+            auto queue_ptr = Context::getInstance().getQueuePtr();
+            queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+        }
+        return;
     }
+
+    send( _connection, messages, 0, [this, _connection, _session]( boost::system::error_code const& ec ){
+        _session->complete();
+        if( ec )
+        {
+            LOG(error) << "Server: Error sending message. Error: " << ec << ", error message: " << ec.message();
+            return;
+        }
+
+        writeSession( _connection, _session );
+    });
 }
 
 std::string ModelSyncServer::hashConnection( std::shared_ptr< WsServer::Connection > const& _connection ) const
@@ -141,14 +220,49 @@ std::string ModelSyncServer::hashConnection( std::shared_ptr< WsServer::Connecti
     return boost::lexical_cast< std::string >( reinterpret_cast< size_t >( _connection.get() ) );
 }
 
-void ModelSyncServer::receiveAction( intermediate_type const& _intermediate_action )
+// Sends the messages as consecutive binary messages, each one after the previous has been written,
+// and reports the outcome of the whole sequence to the callback.
+void ModelSyncServer::send( std::shared_ptr< WsServer::Connection > const& _connection,
+                            SyncSession::message_array_type const& _messages,
+                            size_t const _index,
+                            std::function< void( boost::system::error_code const& ) > const& _callback ) const
+{
+    // The socket drains its SendStream while writing, so each connection gets its own stream
+    // filled straight from the shared parts of the message.
+    auto send_stream = std::make_shared<WsServer::SendStream>();
+    for( auto const& part : _messages[ _index ] )
+    {
+        send_stream->write( part->data(), part->size() );
+    }
+
+    if( ( _index + 1 ) == _messages.size() )
+    {
+        ws_server_ptr->send( _connection, send_stream, _callback, 130 );
+        return;
+    }
+
+    ws_server_ptr->send( _connection, send_stream, [this, _connection, _messages, _index, _callback]( boost::system::error_code const& ec ){
+        if( ec )
+        {
+            _callback( ec );
+            return;
+        }
+
+        send( _connection, _messages, _index + 1, _callback );
+    }, 130 );
+}
+
+void ModelSyncServer::receiveAction( std::string const& _connection_id, intermediate_type const& _intermediate_action )
 {
     if( !isValid( _intermediate_action ) )
     {
         return;
     }
 
-    ActionVariant action = intermediateTypeToSetValueAction( _intermediate_action );
-    auto queue_ptr = Context::getInstance().getQueuePtr();
-    queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+    ActionVariant action = isFrameRequest( _intermediate_action ) ? intermediateTypeToFrameRequestAction( _intermediate_action, _connection_id )
+                                                                  : intermediateTypeToSetValueAction( _intermediate_action );
+    if( !Context::getInstance().pushAction( std::move( action ) ) )
+    {
+        LOG(info) << "Server: Dropped a client update, the action queue is full.";
+    }
 }
@@ -4,11 +4,19 @@
 # include <memory>
 # include <thread>
 # include <string>
+# include <vector>
+# include <tuple>
+# include <mutex>
+# include <functional>
+# include <unordered_map>
 
 # include <server_http.hpp>
 # include <server_ws.hpp>
 
+# include "fence.hpp"
+# include "sdviz.hpp"
 # include "serdes.hpp"
+# include "sync_session.hpp"
 
 namespace sdviz
 {
@@ -27,25 +35,38 @@ namespace sdviz
 
             static ModelSyncServer& getInstance();
 
-            void start( int const _http_port,
-                        int const _http_threads,
-                        int const _ws_port,
-                        int const _ws_threads );
+            void start( Config const& _config );
 
             void wait();
             void stop();
-            void sendAction( intermediate_type const& _intermediate_action );
+            void sendAction( std::vector< SyncSession::update_ptr_type > const& _updates, fence_array_type const& _fences );
+            void sendAction( std::vector< SyncSession::update_ptr_type > const& _updates,
+                             fence_array_type const& _fences,
+                             std::string const& _connection_id );
 
         private:
+            using session_type = std::tuple< std::shared_ptr< WsServer::Connection >, std::shared_ptr< SyncSession > >;
+
             ModelSyncServer() = default;
 
             std::unique_ptr< HttpServer > http_server_ptr;
             std::unique_ptr< WsServer > ws_server_ptr;
             std::thread http_server_thread;
             std::thread ws_server_thread;
+            std::unordered_map< std::string, session_type > sessions;
+            std::mutex sessions_mutex;
 
             std::string hashConnection( std::shared_ptr< WsServer::Connection > const& _connection ) const;
-            void receiveAction( intermediate_type const& _intermediate_action );
+            void sendUpdates( std::vector< SyncSession::update_ptr_type > const& _updates,
+                              fence_array_type const& _fences,
+                              std::vector< session_type > const& _sessions );
+            void writeSession( std::shared_ptr< WsServer::Connection > const& _connection,
+                               std::shared_ptr< SyncSession > const& _session );
+            void send( std::shared_ptr< WsServer::Connection > const& _connection,
+                       SyncSession::message_array_type const& _messages,
+                       size_t const _index,
+                       std::function< void( boost::system::error_code const& ) > const& _callback ) const;
+            void receiveAction( std::string const& _connection_id, intermediate_type const& _intermediate_action );
     };
 }
 
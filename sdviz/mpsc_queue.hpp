@@ -1,87 +1,294 @@
 #ifndef __SDVIZ_MPSC_QUEUE_HPP__
 # define __SDVIZ_MPSC_QUEUE_HPP__
 
-# include <queue>
+# include <array>
+# include <atomic>
 # include <mutex>
+# include <chrono>
+# include <thread>
 # include <condition_variable>
 
 namespace sdviz
 {
-    template< typename ValueType >
+    struct SingleLanePolicy
+    {
+        static constexpr size_t lanes = 1;
+
+        template< typename ValueType >
+        size_t operator()( ValueType const& ) const
+        {
+            return 0;
+        }
+    };
+
+    // Items are queued FIFO per lane and lanes are served in order of their index,
+    // so an item pushed to a lower lane overtakes the ones waiting in higher lanes.
+    //
+    // Producers push onto a lock-free stack per lane. The single consumer takes a whole
+    // stack at once and reverses it into its private FIFO, so neither side takes a lock
+    // on the hot path. A consumer waiting for items spins briefly and then parks on a
+    // condition variable, which producers only signal while it is parked.
+    template< typename ValueType, typename LanePolicy = SingleLanePolicy >
     class MPSCQueue
     {
         public:
             using value_type = ValueType;
 
-            MPSCQueue() = default;
+            MPSCQueue();
             MPSCQueue( MPSCQueue const& _queue ) = delete;
-            MPSCQueue( MPSCQueue&& _queue ) = default;
-            ~MPSCQueue() = default;
+            MPSCQueue( MPSCQueue&& _queue ) = delete;
+            ~MPSCQueue();
 
             MPSCQueue& operator =( MPSCQueue const& _queue ) = delete;
-            MPSCQueue& operator =( MPSCQueue&& _queue ) = default;
+            MPSCQueue& operator =( MPSCQueue&& _queue ) = delete;
 
             value_type& front();
             void pop();
+            template< typename ConsumeFunc >
+            size_t popAll( ConsumeFunc _consume, size_t const _max_items );
             void push( value_type&& item );
+            bool waitUntil( std::chrono::steady_clock::time_point const& _deadline );
             int size();
             void clear();
 
         private:
-            std::queue< value_type > queue;
+            struct Node
+            {
+                value_type value;
+                Node* next;
+            };
+
+            struct Lane
+            {
+                std::atomic< Node* > produced{ nullptr };
+                Node* consumed_head = nullptr;
+            };
+
+            static constexpr int spin_count = 128;
+
+            bool isEmpty() const;
+            bool refill( Lane& _lane );
+            size_t getFrontLane();
+            void park( std::chrono::steady_clock::time_point const* _deadline );
+
+            std::array< Lane, LanePolicy::lanes > lanes;
+            size_t front_lane;
+            std::atomic< int > count;
+            std::atomic< bool > is_parked;
             std::mutex mutex;
             std::condition_variable cond;
     };
 
-    template< typename ValueType >
-    typename MPSCQueue< ValueType >::value_type& MPSCQueue< ValueType >::front()
+    template< typename ValueType, typename LanePolicy >
+    MPSCQueue< ValueType, LanePolicy >::MPSCQueue()
+        : front_lane( 0 ),
+          count( 0 ),
+          is_parked( false )
     {
-        std::unique_lock< std::mutex > mlock( mutex );
-        while( queue.empty() )
+    }
+
+    template< typename ValueType, typename LanePolicy >
+    MPSCQueue< ValueType, LanePolicy >::~MPSCQueue()
+    {
+        clear();
+    }
+
+    template< typename ValueType, typename LanePolicy >
+    typename MPSCQueue< ValueType, LanePolicy >::value_type& MPSCQueue< ValueType, LanePolicy >::front()
+    {
+        int spin = 0;
+        while( ( front_lane = getFrontLane() ) == LanePolicy::lanes )
         {
-            cond.wait( mlock );
+            if( spin < spin_count )
+            {
+                ++spin;
+                std::this_thread::yield();
+                continue;
+            }
+
+            park( nullptr );
         }
 
-        return queue.front();
+        // The consumer pops the item it has seen, even if a higher lane got one in the meantime.
+        return lanes[ front_lane ].consumed_head->value;
     }
 
-    template< typename ValueType >
-    void MPSCQueue< ValueType >::pop()
+    template< typename ValueType, typename LanePolicy >
+    void MPSCQueue< ValueType, LanePolicy >::pop()
     {
-        std::unique_lock< std::mutex > mlock( mutex );
-        while( queue.empty() )
+        if( !lanes[ front_lane ].consumed_head )
         {
-            cond.wait( mlock );
+            front();
         }
 
-        queue.pop();
+        auto& lane = lanes[ front_lane ];
+        Node* const node = lane.consumed_head;
+        lane.consumed_head = node->next;
+        delete node;
+        count.fetch_sub( 1, std::memory_order_relaxed );
     }
 
-    template< typename ValueType >
-    void MPSCQueue< ValueType >::push( value_type&& item )
+    // Hands up to _max_items queued items to _consume in lane order, taking each lane's stack
+    // in one exchange instead of item by item.
+    template< typename ValueType, typename LanePolicy >
+    template< typename ConsumeFunc >
+    size_t MPSCQueue< ValueType, LanePolicy >::popAll( ConsumeFunc _consume, size_t const _max_items )
     {
-        std::unique_lock< std::mutex > mlock( mutex );
-        queue.push( std::move( item ) );
-        mlock.unlock();
-        cond.notify_one();
+        size_t popped = 0;
+        for( auto& lane : lanes )
+        {
+            while( ( popped < _max_items ) && ( lane.consumed_head || refill( lane ) ) )
+            {
+                Node* const node = lane.consumed_head;
+                lane.consumed_head = node->next;
+                _consume( std::move( node->value ) );
+                delete node;
+                ++popped;
+            }
+        }
+
+        count.fetch_sub( popped, std::memory_order_relaxed );
+        return popped;
     }
 
-    template< typename ValueType >
-    int MPSCQueue< ValueType >::size()
+    template< typename ValueType, typename LanePolicy >
+    void MPSCQueue< ValueType, LanePolicy >::push( value_type&& item )
     {
-        std::unique_lock< std::mutex > mlock( mutex );
-        int size = queue.size();
-        mlock.unlock();
+        auto& lane = lanes[ LanePolicy{}( item ) ];
+        Node* const node = new Node{ std::move( item ), lane.produced.load( std::memory_order_relaxed ) };
+        // Counted before it is published, so the consumer never takes the count below zero.
+        count.fetch_add( 1, std::memory_order_relaxed );
+        while( !lane.produced.compare_exchange_weak( node->next, node, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+        {
+        }
 
-        return size;
+        if( is_parked.load( std::memory_order_seq_cst ) )
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            cond.notify_one();
+        }
     }
 
-    template< typename ValueType >
-    void MPSCQueue< ValueType >::clear()
+    template< typename ValueType, typename LanePolicy >
+    bool MPSCQueue< ValueType, LanePolicy >::waitUntil( std::chrono::steady_clock::time_point const& _deadline )
+    {
+        int spin = 0;
+        while( isEmpty() )
+        {
+            if( _deadline <= std::chrono::steady_clock::now() )
+            {
+                return false;
+            }
+
+            if( spin < spin_count )
+            {
+                ++spin;
+                std::this_thread::yield();
+                continue;
+            }
+
+            park( &_deadline );
+        }
+
+        return true;
+    }
+
+    template< typename ValueType, typename LanePolicy >
+    int MPSCQueue< ValueType, LanePolicy >::size()
+    {
+        return count.load( std::memory_order_relaxed );
+    }
+
+    // Must not race with the consumer.
+    template< typename ValueType, typename LanePolicy >
+    void MPSCQueue< ValueType, LanePolicy >::clear()
+    {
+        for( auto& lane : lanes )
+        {
+            Node* node = lane.produced.exchange( nullptr, std::memory_order_acquire );
+            while( node )
+            {
+                Node* const next = node->next;
+                delete node;
+                count.fetch_sub( 1, std::memory_order_relaxed );
+                node = next;
+            }
+
+            node = lane.consumed_head;
+            while( node )
+            {
+                Node* const next = node->next;
+                delete node;
+                count.fetch_sub( 1, std::memory_order_relaxed );
+                node = next;
+            }
+            lane.consumed_head = nullptr;
+        }
+    }
+
+    template< typename ValueType, typename LanePolicy >
+    bool MPSCQueue< ValueType, LanePolicy >::isEmpty() const
+    {
+        for( auto const& lane : lanes )
+        {
+            if( lane.consumed_head || lane.produced.load( std::memory_order_seq_cst ) )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // Refills an empty FIFO by reversing its lane's stack, which holds the newest item first.
+    template< typename ValueType, typename LanePolicy >
+    bool MPSCQueue< ValueType, LanePolicy >::refill( Lane& _lane )
+    {
+        Node* node = _lane.produced.exchange( nullptr, std::memory_order_acquire );
+        if( !node )
+        {
+            return false;
+        }
+
+        Node* reversed = nullptr;
+        while( node )
+        {
+            Node* const next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        _lane.consumed_head = reversed;
+        return true;
+    }
+
+    template< typename ValueType, typename LanePolicy >
+    size_t MPSCQueue< ValueType, LanePolicy >::getFrontLane()
+    {
+        size_t lane_index = 0;
+        while( ( lane_index < LanePolicy::lanes ) && !lanes[ lane_index ].consumed_head && !refill( lanes[ lane_index ] ) )
+        {
+            ++lane_index;
+        }
+
+        return lane_index;
+    }
+
+    template< typename ValueType, typename LanePolicy >
+    void MPSCQueue< ValueType, LanePolicy >::park( std::chrono::steady_clock::time_point const* _deadline )
     {
         std::unique_lock< std::mutex > mlock( mutex );
-        std::queue< value_type >().swap( queue );
-        mlock.unlock();
+        is_parked.store( true, std::memory_order_seq_cst );
+        auto const is_ready = [this](){ return !isEmpty(); };
+        if( _deadline )
+        {
+            cond.wait_until( mlock, *_deadline, is_ready );
+        }
+        else
+        {
+            cond.wait( mlock, is_ready );
+        }
+        is_parked.store( false, std::memory_order_seq_cst );
     }
 }
 
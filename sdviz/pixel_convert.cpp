@@ -0,0 +1,214 @@
+#include "./pixel_convert.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+# include <tmmintrin.h>
+#endif
+
+using namespace sdviz;
+
+namespace
+{
+    float loadFloat( uint8_t const* const _src )
+    {
+        float value;
+        std::memcpy( &value, _src, sizeof( value ) );
+        return value;
+    }
+
+    void swizzleBGRToRGB( uint8_t const* const _src, uint8_t* const _dst, size_t const _pixels )
+    {
+        size_t i = 0;
+#ifdef __SSSE3__
+        // Five pixels per step. The 16th byte stored belongs to the next pixel, which the next
+        // step or the scalar tail writes again.
+        __m128i const mask = _mm_setr_epi8( 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15 );
+        for( ; i + 6 <= _pixels; i += 5 )
+        {
+            __m128i const bgr = _mm_loadu_si128( reinterpret_cast< __m128i const* >( _src + 3 * i ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( _dst + 3 * i ), _mm_shuffle_epi8( bgr, mask ) );
+        }
+#endif
+        for( ; i < _pixels; ++i )
+        {
+            _dst[ 3 * i + 0 ] = _src[ 3 * i + 2 ];
+            _dst[ 3 * i + 1 ] = _src[ 3 * i + 1 ];
+            _dst[ 3 * i + 2 ] = _src[ 3 * i + 0 ];
+        }
+    }
+
+    void swizzleBGRAToRGBA( uint8_t const* const _src, uint8_t* const _dst, size_t const _pixels )
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        // Swaps the low and the third byte of each little endian 32 bit pixel.
+        __m128i const green_alpha = _mm_set1_epi32( static_cast< int >( 0xff00ff00 ) );
+        __m128i const low_byte = _mm_set1_epi32( 0x000000ff );
+        for( ; i + 4 <= _pixels; i += 4 )
+        {
+            __m128i const bgra = _mm_loadu_si128( reinterpret_cast< __m128i const* >( _src + 4 * i ) );
+            __m128i const red = _mm_and_si128( _mm_srli_epi32( bgra, 16 ), low_byte );
+            __m128i const blue = _mm_slli_epi32( _mm_and_si128( bgra, low_byte ), 16 );
+            __m128i const rgba = _mm_or_si128( _mm_and_si128( bgra, green_alpha ), _mm_or_si128( red, blue ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( _dst + 4 * i ), rgba );
+        }
+#endif
+        for( ; i < _pixels; ++i )
+        {
+            _dst[ 4 * i + 0 ] = _src[ 4 * i + 2 ];
+            _dst[ 4 * i + 1 ] = _src[ 4 * i + 1 ];
+            _dst[ 4 * i + 2 ] = _src[ 4 * i + 0 ];
+            _dst[ 4 * i + 3 ] = _src[ 4 * i + 3 ];
+        }
+    }
+
+    // NaNs fail every comparison and are skipped.
+    void updateFloatRange( uint8_t const* const _src, size_t const _count, float& _min, float& _max )
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        if( 4 <= _count )
+        {
+            __m128 min4 = _mm_set1_ps( _min );
+            __m128 max4 = _mm_set1_ps( _max );
+            for( ; i + 4 <= _count; i += 4 )
+            {
+                __m128 const values = _mm_loadu_ps( reinterpret_cast< float const* >( _src + 4 * i ) );
+                min4 = _mm_min_ps( values, min4 );
+                max4 = _mm_max_ps( values, max4 );
+            }
+
+            float mins[4];
+            float maxs[4];
+            _mm_storeu_ps( mins, min4 );
+            _mm_storeu_ps( maxs, max4 );
+            _min = *std::min_element( mins, mins + 4 );
+            _max = *std::max_element( maxs, maxs + 4 );
+        }
+#endif
+        for( ; i < _count; ++i )
+        {
+            float const value = loadFloat( _src + 4 * i );
+            _min = ( value < _min ) ? value : _min;
+            _max = ( _max < value ) ? value : _max;
+        }
+    }
+
+    // Maps ( value - _min ) * _scale to [0, 65535], rounding to nearest. NaNs become 0.
+    void normalizeFloatToUInt16( uint8_t const* const _src, uint8_t* const _dst, size_t const _count, float const _min, float const _scale )
+    {
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128 const min4 = _mm_set1_ps( _min );
+        __m128 const scale4 = _mm_set1_ps( _scale );
+        __m128 const zero4 = _mm_setzero_ps();
+        __m128 const top4 = _mm_set1_ps( 65535.0f );
+        // SSE2 only packs with signed saturation, so the values are packed around zero and
+        // shifted back by flipping the sign bit.
+        __m128i const bias = _mm_set1_epi32( 32768 );
+        __m128i const sign_bit = _mm_set1_epi16( static_cast< short >( 0x8000 ) );
+        auto const normalize = [&]( uint8_t const* const _values ){
+            __m128 const values = _mm_loadu_ps( reinterpret_cast< float const* >( _values ) );
+            __m128 const scaled = _mm_mul_ps( _mm_sub_ps( values, min4 ), scale4 );
+            return _mm_sub_epi32( _mm_cvtps_epi32( _mm_min_ps( _mm_max_ps( scaled, zero4 ), top4 ) ), bias );
+        };
+        for( ; i + 8 <= _count; i += 8 )
+        {
+            __m128i const packed = _mm_packs_epi32( normalize( _src + 4 * i ), normalize( _src + 4 * i + 16 ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i* >( _dst + 2 * i ), _mm_xor_si128( packed, sign_bit ) );
+        }
+#endif
+        for( ; i < _count; ++i )
+        {
+            float const scaled = ( loadFloat( _src + 4 * i ) - _min ) * _scale;
+            float const clamped = std::min( ( 0.0f < scaled ) ? scaled : 0.0f, 65535.0f );
+            uint16_t const value = static_cast< uint16_t >( std::lrint( clamped ) );
+            std::memcpy( _dst + 2 * i, &value, sizeof( value ) );
+        }
+    }
+}
+
+ImageImpl::Format sdviz::PixelConverter::GetWireFormat( ImageImpl::Format const _format )
+{
+    switch( _format )
+    {
+        case ImageImpl::Format::BGR_888:
+            return ImageImpl::Format::RGB_888;
+        case ImageImpl::Format::BGRA_8888:
+            return ImageImpl::Format::RGBA_8888;
+        case ImageImpl::Format::FLOAT_32:
+            return ImageImpl::Format::UINT_16;
+        default:
+            return _format;
+    }
+}
+
+ImageImpl::value_range_type sdviz::PixelConverter::GetValueRange( ImageImpl const& _image )
+{
+    float min = std::numeric_limits< float >::infinity();
+    float max = -std::numeric_limits< float >::infinity();
+    if( _image.getFormat() == ImageImpl::Format::FLOAT_32 )
+    {
+        for( int row = 0; row < _image.getHeight(); ++row )
+        {
+            updateFloatRange( _image.getBuffer() + row * _image.getStride(), _image.getWidth(), min, max );
+        }
+    }
+
+    return ImageImpl::value_range_type{ min, max };
+}
+
+sdviz::PixelConverter::PixelConverter( ImageImpl const& _image, ImageImpl::value_range_type const& _value_range )
+    : format( _image.getFormat() ),
+      width( _image.getWidth() ),
+      row_size( ( format == ImageImpl::Format::FLOAT_32 ) ? width * sizeof( uint16_t ) : ImageImpl::GetRowSize( _image ) ),
+      min_value( 0.0f ),
+      scale( 1.0f )
+{
+    if( format != ImageImpl::Format::FLOAT_32 )
+    {
+        return;
+    }
+
+    float const min = std::get<0>( _value_range );
+    float const max = std::get<1>( _value_range );
+    float const range = max - min;
+    min_value = std::isfinite( min ) ? min : 0.0f;
+    scale = ( std::isfinite( range ) && ( 0.0f < range ) ) ? 65535.0f / range : 0.0f;
+}
+
+bool sdviz::PixelConverter::isIdentity() const noexcept
+{
+    return GetWireFormat( format ) == format;
+}
+
+size_t sdviz::PixelConverter::getRowSize() const noexcept
+{
+    return row_size;
+}
+
+void sdviz::PixelConverter::convertRow( uint8_t const* const _src, uint8_t* const _dst ) const
+{
+    switch( format )
+    {
+        case ImageImpl::Format::BGR_888:
+            swizzleBGRToRGB( _src, _dst, width );
+            break;
+        case ImageImpl::Format::BGRA_8888:
+            swizzleBGRAToRGBA( _src, _dst, width );
+            break;
+        case ImageImpl::Format::FLOAT_32:
+            normalizeFloatToUInt16( _src, _dst, width, min_value, scale );
+            break;
+        default:
+            std::copy( _src, _src + row_size, _dst );
+            break;
+    }
+}
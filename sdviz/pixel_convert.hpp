@@ -0,0 +1,37 @@
+#ifndef __SDVIZ_PIXEL_CONVERT_HPP__
+# define __SDVIZ_PIXEL_CONVERT_HPP__
+
+# include <cstddef>
+# include <cstdint>
+
+# include "./image_impl.hpp"
+
+namespace sdviz
+{
+    // Converts the rows of an image to the format it is sent in. The client knows neither the
+    // BGR channel orders nor float pixels, so those are swizzled to RGB and normalized to
+    // UINT_16 over the given range, which is that of the whole image even when converting a
+    // tile or a pyramid level of it.
+    class PixelConverter final
+    {
+        public:
+            static ImageImpl::Format GetWireFormat( ImageImpl::Format const _format );
+            // Scans FLOAT_32 images only; other formats get an empty range.
+            static ImageImpl::value_range_type GetValueRange( ImageImpl const& _image );
+
+            PixelConverter( ImageImpl const& _image, ImageImpl::value_range_type const& _value_range );
+
+            bool isIdentity() const noexcept;
+            size_t getRowSize() const noexcept;
+            void convertRow( uint8_t const* const _src, uint8_t* const _dst ) const;
+
+        private:
+            ImageImpl::Format format;
+            size_t width;
+            size_t row_size;
+            float min_value;
+            float scale;
+    };
+}
+
+#endif // __SDVIZ_PIXEL_CONVERT_HPP__
@@ -1,7 +1,6 @@
-# include <boost/uuid/uuid.hpp>
-# include <boost/uuid/uuid_io.hpp>
-# include <boost/uuid/uuid_generators.hpp>
-# include <boost/lexical_cast.hpp>
+# include <mutex>
+# include <stdexcept>
+# include <vector>
 
 # include "resource.hpp"
 
@@ -56,23 +55,63 @@ std::string const sdviz::getMainPage()
     return main_page;
 }
 
-std::string sdviz::generateElmenetId()
+element_id_type const sdviz::dummy_id{ 0 };
+element_id_type const sdviz::page_id{ 1 };
+
+namespace
 {
-    return boost::lexical_cast< std::string >( boost::uuids::random_generator()() );
+    std::mutex element_id_mutex;
+    element_id_type next_element_index{ page_id + 1 };
+    std::vector< element_id_type > released_element_ids;
 }
 
-bool sdviz::isValidElementId( std::string const& _id )
+element_id_type sdviz::generateElmenetId()
 {
-    bool const isValidElementId = ( 0 < element_store.count( _id ) );
+    std::lock_guard< std::mutex > lock( element_id_mutex );
+    if( released_element_ids.empty() )
+    {
+        if( element_index_mask < next_element_index )
+        {
+            throw std::runtime_error( "Too many elements." );
+        }
+        return next_element_index++;
+    }
+
+    element_id_type const released_id = released_element_ids.back();
+    released_element_ids.pop_back();
+    element_id_type const generation = ( released_id >> element_index_bits ) + 1;
+    return ( generation << element_index_bits ) | ( released_id & element_index_mask );
+}
+
+// A slot whose generation would wrap is retired instead, as its next id would match one handed
+// out before and a client still showing that element could be resynced with the wrong one.
+void sdviz::releaseElementId( element_id_type const _id )
+{
+    if( ( _id >> element_index_bits ) == ( ~element_id_type( 0 ) >> element_index_bits ) )
+    {
+        return;
+    }
+
+    std::lock_guard< std::mutex > lock( element_id_mutex );
+    released_element_ids.emplace_back( _id );
+}
+
+bool sdviz::isValidElementId( element_id_type const _id )
+{
+    bool const isValidElementId = ( nullptr != element_store.find( _id ) );
 
     return isValidElementId;
 }
 
-std::string sdviz::dummy_id{ "" };
-std::string sdviz::page_id{ "__page__" };
+ElementStore sdviz::element_store;
 
-ElementStore::value_type initial_elements[] = { std::make_pair( page_id,
-                                                                ContainerElementImpl{ LayoutImpl{},
-                                                                                      ContainerElementImplParam{ "", true } } ) };
-ElementStore sdviz::element_store{ std::make_move_iterator( std::begin( initial_elements ) ),
-                                   std::make_move_iterator( std::end( initial_elements ) ) };
+namespace
+{
+    struct PageInitializer
+    {
+        PageInitializer()
+        {
+            element_store.insert( page_id, ContainerElementImpl{ LayoutImpl{}, ContainerElementImplParam{ "", true } } );
+        }
+    } page_initializer;
+}
@@ -2,22 +2,125 @@
 # define __SDVIZ_RESOURCE_HPP__
 
 # include <string>
-# include <unordered_map>
+# include <stdexcept>
+# include <vector>
 
+# include <boost/optional.hpp>
 # include <boost/variant.hpp>
 
 # include "element_impl.hpp"
+# include "sdviz.hpp"
 
 namespace sdviz
 {
-    using ElementStore = std::unordered_map< std::string, ElementImplVariant >;
+    // The low bits of an element id index its slot in the store, the high bits count how often
+    // the slot has been reused, so that ids of deleted elements never match a later one. Those
+    // leave room for 256 generations, after which the slot is not reused anymore.
+    element_id_type const element_index_bits = 24;
+    element_id_type const element_index_mask = ( element_id_type( 1 ) << element_index_bits ) - 1;
+
+    // Elements indexed by the slot of their id, along with the containers they were added to.
+    class ElementStore final
+    {
+        public:
+            ElementStore() = default;
+            ElementStore( ElementStore const& ) = delete;
+            ElementStore( ElementStore&& ) = delete;
+            ~ElementStore() = default;
+
+            ElementStore& operator =( ElementStore const& ) = delete;
+            ElementStore& operator =( ElementStore&& ) = delete;
+
+            void insert( element_id_type const _id, ElementImplVariant&& _element )
+            {
+                element_id_type const index = _id & element_index_mask;
+                if( slots.size() <= index )
+                {
+                    slots.resize( index + 1 );
+                }
+
+                auto& slot = slots[ index ];
+                slot.id = _id;
+                slot.element = std::move( _element );
+                slot.parent_ids.clear();
+            }
+
+            // Returns the ids of the containers the element was added to.
+            std::vector< element_id_type > erase( element_id_type const _id )
+            {
+                if( !find( _id ) )
+                {
+                    return std::vector< element_id_type >{};
+                }
+
+                auto& slot = slots[ _id & element_index_mask ];
+                slot.element = boost::none;
+                return std::move( slot.parent_ids );
+            }
+
+            void addParent( element_id_type const _id, element_id_type const _parent_id )
+            {
+                if( find( _id ) )
+                {
+                    slots[ _id & element_index_mask ].parent_ids.emplace_back( _parent_id );
+                }
+            }
+
+            ElementImplVariant* find( element_id_type const _id )
+            {
+                element_id_type const index = _id & element_index_mask;
+                bool const is_found = ( index < slots.size() ) && slots[ index ].element && ( slots[ index ].id == _id );
+                return is_found ? slots[ index ].element.get_ptr() : nullptr;
+            }
+
+            ElementImplVariant const* find( element_id_type const _id ) const
+            {
+                element_id_type const index = _id & element_index_mask;
+                bool const is_found = ( index < slots.size() ) && slots[ index ].element && ( slots[ index ].id == _id );
+                return is_found ? slots[ index ].element.get_ptr() : nullptr;
+            }
+
+            ElementImplVariant& at( element_id_type const _id )
+            {
+                auto const element = find( _id );
+                if( !element )
+                {
+                    throw std::out_of_range( "Element is not found." );
+                }
+                return *element;
+            }
+
+            template< typename FuncType >
+            void forEach( FuncType _func ) const
+            {
+                for( auto const& slot : slots )
+                {
+                    if( slot.element )
+                    {
+                        _func( slot.id, *slot.element );
+                    }
+                }
+            }
+
+        private:
+            struct Slot
+            {
+                element_id_type id = 0;
+                boost::optional< ElementImplVariant > element;
+                std::vector< element_id_type > parent_ids;
+            };
+
+            std::vector< Slot > slots;
+    };
 
     std::string const getMainPage();
-    std::string generateElmenetId();
-    bool isValidElementId( std::string const& _id );
+    element_id_type generateElmenetId();
+    // Makes the slot of a deleted element available to generateElmenetId.
+    void releaseElementId( element_id_type const _id );
+    bool isValidElementId( element_id_type const _id );
 
-    extern std::string dummy_id;
-    extern std::string page_id;
+    extern element_id_type const dummy_id;
+    extern element_id_type const page_id;
     extern ElementStore element_store;
 }
 
@@ -5,34 +5,112 @@
 #include <algorithm>
 
 #include "action.hpp"
+#include "callback_executor.hpp"
 #include "context.hpp"
+#include "fence.hpp"
 #include "canvas_impl.hpp"
 #include "image_impl.hpp"
 #include "model_sync_server.hpp"
 #include "resource.hpp"
 #include "sdviz.hpp"
+#include "tile_cache.hpp"
 #include "type_util.hpp"
+#include "update_encoder.hpp"
 
 using namespace sdviz;
 
 namespace
 {
-    void addElement( std::string const& _container_id, std::string const& _element_id, int _span )
+    void addElement( element_id_type const _container_id, element_id_type const _element_id, int _span )
     {
         ActionVariant action{ AddElementImplAction{ _container_id, std::make_tuple( _span, _element_id ) } };
         auto queue_ptr = Context::getInstance().getQueuePtr();
         queue_ptr->push( std::make_tuple( std::move( action ), true ) );
     }
+
+    template< typename ElementType >
+    void pushCreateAction( element_id_type const _id,
+                           typename ImplTypeTraits< ElementType >::type::value_type&& _impl_value,
+                           typename ElementType::param_type const& _param )
+    {
+        using impl_type = typename ImplTypeTraits< ElementType >::type;
+        using set_element_action_type = Action< ElementImplVariant >;
+
+        typename impl_type::param_type impl_param{ convertToImplParam< ElementType >( _param ) };
+        impl_type element_impl{ std::move( _impl_value ), std::move( impl_param ) };
+        ActionVariant action{ set_element_action_type{ _id, ElementImplVariant{ std::move( element_impl ) } } };
+
+        auto queue_ptr = Context::getInstance().getQueuePtr();
+        queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+    }
+
+    std::future< void > pushFence()
+    {
+        auto fence = std::make_shared< Fence >();
+        auto future = fence->getFuture();
+        Context::getInstance().pushFence( fence );
+        return future;
+    }
+
+    std::future< void > makeRejectedFuture()
+    {
+        std::promise< void > promise;
+        promise.set_exception( std::make_exception_ptr( std::runtime_error( "The action queue is full." ) ) );
+        return promise.get_future();
+    }
+
+    template< typename ElementType >
+    bool pushSetValueAction( element_id_type const _id, typename ImplTypeTraits< ElementType >::type::value_type&& _impl_value )
+    {
+        using impl_type = typename ImplTypeTraits< ElementType >::type;
+        using set_value_action_type = typename ActionTypeTraits< impl_type >::set_value_type;
+
+        ActionVariant action{ set_value_action_type{ _id, std::move( _impl_value ) } };
+        return Context::getInstance().pushAction( std::move( action ) );
+    }
+}
+
+Image::Image( int const _width, int const _height, Format const _format, uint8_t* const _buffer, size_t const _stride )
+    : pimpl{ std::make_shared< ImageImpl >( _width, _height, convertToImageImplFormat( _format ), _buffer, _stride ) }
+{
+}
+
+Image::Image( int const _width, int const _height, Format const _format, std::shared_ptr< uint8_t > const _buffer, size_t const _stride )
+    : pimpl{ std::make_shared< ImageImpl >( _width, _height, convertToImageImplFormat( _format ), _buffer, _stride ) }
+{
 }
 
-Image::Image( int const _width, int const _height, Format const _format, uint8_t* const _buffer )
-    : pimpl{ std::make_shared< ImageImpl >( _width, _height, convertToImageImplFormat( _format ), _buffer ) }
+Image::Image( std::shared_ptr< ImageImpl > const& _pimpl )
+    : pimpl{ _pimpl }
 {
 }
 
-Image::Image( int const _width, int const _height, Format const _format, std::shared_ptr< uint8_t > const _buffer )
-    : pimpl{ std::make_shared< ImageImpl >( _width, _height, convertToImageImplFormat( _format ), _buffer ) }
+Image& Image::freeze() noexcept
 {
+    pimpl->freeze();
+    return *this;
+}
+
+bool Image::isFrozen() const noexcept
+{
+    return pimpl->isFrozen();
+}
+
+Image Image::getRegion( int const _x, int const _y, int const _width, int const _height ) const
+{
+    return Image{ std::make_shared< ImageImpl >( pimpl->getRegion( _x, _y, _width, _height ) ) };
+}
+
+Image& Image::enablePyramid()
+{
+    pimpl->enablePyramid();
+    return *this;
+}
+
+Image& Image::enableTiling()
+{
+    pimpl->enableTiling();
+    return *this;
 }
 
 int Image::getWidth() const noexcept
@@ -50,11 +128,21 @@ Image::Format Image::getFormat() const noexcept
     return convertToImageFormat( pimpl->getFormat() );
 }
 
-uint8_t* Image::getBuffer() const noexcept
+size_t Image::getStride() const noexcept
+{
+    return pimpl->getStride();
+}
+
+uint8_t const* Image::getBuffer() const noexcept
 {
     return pimpl->getBuffer();
 }
 
+uint8_t* Image::getBuffer()
+{
+    return pimpl->getMutableBuffer();
+}
+
 ImageImpl* Image::getImpl() const noexcept
 {
     return pimpl.get();
@@ -68,11 +156,25 @@ sdviz::Canvas::Canvas( int const _width, int const _height )
 void sdviz::Canvas::drawImage( Image const& _image, value_type const& _pos, double _opacity )
 {
     double opacity = std::min( std::max( 0.0, _opacity ), 1.0 );
-    ImageImpl image_impl{ _image.getImpl()->clone() };
+    ImageImpl image_impl{ _image.isFrozen() ? *_image.getImpl() : _image.getImpl()->clone() };
     auto draw_image = CanvasImpl::ImageCommand( std::move( image_impl ), std::get<0>( _pos ), std::get<1>( _pos ), opacity );
     pimpl->addCommand( std::move( draw_image ) );
 }
 
+// An image wrapping a raw buffer of the caller is copied unless it was frozen, as the buffer
+// may be reused once the call returns while the encoder still reads it.
+void sdviz::Canvas::drawImage( Image&& _image, value_type const& _pos, double _opacity )
+{
+    Image image{ std::move( _image ) };
+    if( image.getImpl()->isBorrowed() && !image.isFrozen() )
+    {
+        drawImage( static_cast< Image const& >( image ), _pos, _opacity );
+        return;
+    }
+
+    drawImage( image.freeze(), _pos, _opacity );
+}
+
 void sdviz::Canvas::drawRect( value_type const& _lt, value_type const& _rb, color_type _color, uint8_t _line_width, bool _fill, bool _with_dots )
 {
     auto const draw_rect = CanvasImpl::RectCommand( std::get<0>( _lt ),
@@ -148,9 +250,56 @@ CanvasImpl* sdviz::Canvas::getImpl() const noexcept
     return pimpl.get();
 }
 
+bool sdviz::Canvas::isShared() const noexcept
+{
+    return 1 < pimpl.use_count();
+}
+
+// Making sure the context exists before any handle of the element does gets it destroyed after
+// them, so the delete of an element kept in a static is still queued to a live context.
+ElementHolder::ElementHolder( element_id_type const _id, size_t const _lane )
+    : id( _id ),
+      lane( _lane ),
+      is_removed( false )
+{
+    Context::getInstance();
+}
+
+ElementHolder::~ElementHolder()
+{
+    remove();
+}
+
+void ElementHolder::addChild( std::shared_ptr< ElementHolder > const& _child )
+{
+    std::lock_guard< std::mutex > lock( children_mutex );
+    children.emplace_back( _child );
+}
+
+// Children are let go after the delete action is queued, so a container is deleted ahead of
+// the elements only it was holding.
+void ElementHolder::remove()
+{
+    if( is_removed.exchange( true ) )
+    {
+        return;
+    }
+
+    ActionVariant action{ DeleteElementImplAction{ id, DeleteRequest{ lane } } };
+    auto queue_ptr = Context::getInstance().getQueuePtr();
+    queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+
+    std::vector< std::shared_ptr< ElementHolder > > released_children;
+    {
+        std::lock_guard< std::mutex > lock( children_mutex );
+        released_children.swap( children );
+    }
+}
+
 template< typename ValueType, typename ParamType >
-Element< ValueType, ParamType >::Element( std::string const& _id )
-    : id( _id )
+Element< ValueType, ParamType >::Element( std::shared_ptr< ElementHolder > const& _holder )
+    : id( _holder->id ),
+      holder( _holder )
 {
 }
 
@@ -158,32 +307,52 @@ template< typename ValueType, typename ParamType >
 Element< ValueType, ParamType > Element< ValueType, ParamType >::create( value_type const& _value, param_type const& _param )
 {
     using impl_type = typename ImplTypeTraits< Element >::type;
-    using set_element_action_type = Action< ElementImplVariant >;
 
-    auto id = generateElmenetId();
-    auto element = Element( id );
+    auto element = Element( std::make_shared< ElementHolder >( generateElmenetId(), ElementLane< impl_type >::value ) );
+    pushCreateAction< Element >( element.id, convertToImplValue< Element >( _value ), _param );
+    return element;
+}
 
-    typename impl_type::value_type impl_value{ convertToImplValue< Element >( _value ) };
-    typename impl_type::param_type impl_param{ convertToImplParam< Element >( _param ) };
-    impl_type element_impl{ std::move( impl_value ), std::move( impl_param ) };
-    ActionVariant action{ set_element_action_type{ id, ElementImplVariant{ std::move( element_impl ) } } };
+template< typename ValueType, typename ParamType >
+Element< ValueType, ParamType > Element< ValueType, ParamType >::create( value_type&& _value, param_type const& _param )
+{
+    using impl_type = typename ImplTypeTraits< Element >::type;
 
-    auto queue_ptr = Context::getInstance().getQueuePtr();
-    queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+    auto element = Element( std::make_shared< ElementHolder >( generateElmenetId(), ElementLane< impl_type >::value ) );
+    pushCreateAction< Element >( element.id, convertToImplValue< Element >( std::move( _value ) ), _param );
     return element;
 }
 
 template< typename ValueType, typename ParamType >
-void Element< ValueType, ParamType >::setValue( value_type const& _value )
+bool Element< ValueType, ParamType >::setValue( value_type const& _value )
 {
-    using impl_type = typename ImplTypeTraits< Element >::type;
-    using set_value_action_type = typename ActionTypeTraits< impl_type >::set_value_type;
+    return pushSetValueAction< Element >( id, convertToImplValue< Element >( _value ) );
+}
+
+template< typename ValueType, typename ParamType >
+bool Element< ValueType, ParamType >::setValue( value_type&& _value )
+{
+    return pushSetValueAction< Element >( id, convertToImplValue< Element >( std::move( _value ) ) );
+}
 
-    typename impl_type::value_type impl_value{ convertToImplValue< Element >( _value ) };
-    ActionVariant action{ set_value_action_type{ id, std::move(impl_value) } };
+template< typename ValueType, typename ParamType >
+std::future< void > Element< ValueType, ParamType >::setValueAsync( value_type const& _value )
+{
+    if( !setValue( _value ) )
+    {
+        return makeRejectedFuture();
+    }
+    return pushFence();
+}
 
-    auto queue_ptr = Context::getInstance().getQueuePtr();
-    queue_ptr->push( std::make_tuple( std::move( action ), true ) );
+template< typename ValueType, typename ParamType >
+std::future< void > Element< ValueType, ParamType >::setValueAsync( value_type&& _value )
+{
+    if( !setValue( std::move( _value ) ) )
+    {
+        return makeRejectedFuture();
+    }
+    return pushFence();
 }
 
 template< typename ValueType, typename ParamType >
@@ -199,10 +368,17 @@ void Element< ValueType, ParamType >::setParam( param_type const& _param )
     queue_ptr->push( std::make_tuple( std::move( action ), true ) );
 }
 
-ContainerElement::ContainerElement( std::string const& _id, std::string const& _label, bool _is_row_direction )
-    : id{ _id },
+template< typename ValueType, typename ParamType >
+void Element< ValueType, ParamType >::remove()
+{
+    holder->remove();
+}
+
+ContainerElement::ContainerElement( std::shared_ptr< ElementHolder > const& _holder, std::string const& _label, bool _is_row_direction )
+    : id{ _holder->id },
       label{ _label },
-      _is_row_direction{ _is_row_direction }
+      _is_row_direction{ _is_row_direction },
+      holder{ _holder }
 {
 }
 
@@ -210,20 +386,26 @@ ContainerElement ContainerElement::create( std::string const& _label, bool _is_r
 {
     using set_element_action_type = Action< ElementImplVariant >;
 
-    auto id = generateElmenetId();
-    auto element = ContainerElement( id, _label, _is_row_direction );
+    auto holder = std::make_shared< ElementHolder >( generateElmenetId(), ElementLane< ContainerElementImpl >::value );
+    auto element = ContainerElement( holder, _label, _is_row_direction );
 
     ContainerElementImpl element_impl{ LayoutImpl{}, ContainerElementImplParam{ _label, _is_row_direction } };
-    ActionVariant action{ set_element_action_type{ id, ElementImplVariant{ std::move( element_impl ) } } };
+    ActionVariant action{ set_element_action_type{ element.id, ElementImplVariant{ std::move( element_impl ) } } };
 
     auto queue_ptr = Context::getInstance().getQueuePtr();
     queue_ptr->push( std::make_tuple( std::move( action ), true ) );
     return element;
 }
 
-void ContainerElement::addElement( std::string const& _id )
+void ContainerElement::remove()
+{
+    holder->remove();
+}
+
+void ContainerElement::addElement( std::shared_ptr< ElementHolder > const& _child )
 {
-    ::addElement( id, _id, 1 );
+    holder->addChild( _child );
+    ::addElement( id, _child->id, 1 );
 }
 
 Page::Page()
@@ -231,10 +413,11 @@ Page::Page()
 {
 }
 
+// Never destroyed, so the elements on the page are not deleted while the process exits.
 Page& sdviz::Page::getInstance()
 {
-    static Page instance;
-    return instance;
+    static Page* const instance = new Page();
+    return *instance;
 }
 
 void Page::endl( Page& _page )
@@ -251,7 +434,13 @@ std::function< void( Page& ) > Page::setw( int _w )
     return set_width_func;
 }
 
-void Page::addElement( std::string const& _id )
+void Page::addElement( std::shared_ptr< ElementHolder > const& _holder )
+{
+    holders.emplace_back( _holder );
+    addElement( _holder->id );
+}
+
+void Page::addElement( element_id_type const _id )
 {
     ::addElement( page_id, _id, span );
     span = 1;
@@ -259,11 +448,11 @@ void Page::addElement( std::string const& _id )
 
 bool sdviz::start( sdviz::Config const& _config )
 {
-    Context::getInstance().start();
-    ModelSyncServer::getInstance().start( _config.http_port,
-                                          _config.http_threads,
-                                          _config.ws_port,
-                                          _config.ws_threads );
+    CallbackExecutor::getInstance().start( _config );
+    TileCache::getInstance().start( _config );
+    UpdateEncoder::getInstance().start( _config );
+    Context::getInstance().start( _config );
+    ModelSyncServer::getInstance().start( _config );
     return true;
 }
 
@@ -277,6 +466,14 @@ void sdviz::stop()
 {
     ModelSyncServer::getInstance().stop();
     Context::getInstance().stop();
+    UpdateEncoder::getInstance().stop();
+    TileCache::getInstance().stop();
+    CallbackExecutor::getInstance().stop();
+}
+
+void sdviz::flush()
+{
+    pushFence().wait();
 }
 
 template class sdviz::Element< std::string, sdviz::TextElementParam >;
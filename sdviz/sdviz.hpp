@@ -1,51 +1,121 @@
 #ifndef _SDVIZ_HPP_
 # define _SDVIZ_HPP_
 
+# include <atomic>
 # include <string>
 # include <map>
+# include <mutex>
 # include <memory>
 # include <vector>
 # include <cstdint>
 # include <stdexcept>
+# include <functional>
+# include <future>
 # include <initializer_list>
 
 namespace sdviz
 {
     struct Config
     {
+        enum OverflowPolicy
+        {
+            Block,
+            DropOldest,
+            Reject
+        };
+
         int http_port = 8080;
         int http_threads = 2;
         int ws_port = 8888;
         int ws_threads = 2;
+        // Outbound budget of each connection. Unsent updates beyond it are dropped
+        // and the affected elements are resent once the connection catches up.
+        int max_queued_frames = 1024;
+        int max_queued_bytes = 64 * 1024 * 1024;
+        // Set-value actions queued within this window are collapsed per element
+        // into the last one before serialization. 0 disables coalescing.
+        int coalescing_interval_ms = 0;
+        // Element updates are sent in batches of at most this many updates and bytes,
+        // one WebSocket message per batch. A batch waits up to the latency for more
+        // actions to arrive before it is sent; 0 sends whatever is queued right away.
+        int max_batch_updates = 256;
+        int max_batch_bytes = 1024 * 1024;
+        int batch_latency_ms = 0;
+        // Worker threads running on_value_changed callbacks; 0 runs them on the sync loop.
+        // With more than one, callbacks of different elements may run concurrently.
+        // Serial callbacks of one element never overlap and keep their order.
+        int callback_threads = 1;
+        bool serial_callbacks_per_element = true;
+        // Worker threads serializing element updates; 0 serializes them on the sync loop.
+        // Updates are sent in the order they were made whichever worker finishes first.
+        int encoder_threads = 2;
+        // Capacity of the action queue for setValue calls; 0 means unbounded. When it is full
+        // the producer is blocked, its update replaces a pending overflowed update of the same
+        // element, or setValue returns false. Other actions are always accepted, and the sync
+        // loop itself is never blocked.
+        int max_queued_actions = 0;
+        OverflowPolicy overflow_policy = Block;
+        // Compressed tiles of tiled images kept for other clients and revisits, least
+        // recently used ones being evicted beyond this size.
+        int max_tile_cache_bytes = 256 * 1024 * 1024;
     };
 
     class ImageImpl;
     class Image final
     {
         public:
+            // FLOAT_32 images are shown normalized to the range of their values.
             enum Format
             {
                 RGB_888,
                 UINT_8,
-                UINT_16
+                UINT_16,
+                BGR_888,
+                BGRA_8888,
+                RGBA_8888,
+                INT_16,
+                FLOAT_32
             };
 
-            Image( int const _width, int const _height, Format const _format, uint8_t* const _buffer = nullptr );
-            Image( int const _width, int const _height, Format const _format, std::shared_ptr<uint8_t> const _buffer );
+            // _stride is the byte distance between rows, zero for tightly packed rows. An external
+            // buffer is not copied, so padded rows such as those of an OpenCV Mat can be passed as is.
+            Image( int const _width, int const _height, Format const _format, uint8_t* const _buffer = nullptr, size_t const _stride = 0 );
+            Image( int const _width, int const _height, Format const _format, std::shared_ptr<uint8_t> const _buffer, size_t const _stride = 0 );
             Image( Image const& _image_impl ) = default;
             Image( Image&& _image_impl ) = default;
             ~Image() = default;
 
+            // A frozen image shares its pixels with the canvases it is drawn on instead of being
+            // copied. Writing through the non-const getBuffer() copies them first if they are
+            // still shared, and thaws the image. A caller owned buffer must not be written
+            // through its own pointer while frozen.
+            Image& freeze() noexcept;
+            bool isFrozen() const noexcept;
+
+            // A view of a rectangle of this image which shares its pixels.
+            Image getRegion( int const _x, int const _y, int const _width, int const _height ) const;
+
+            // Sends the image as a pyramid of halved resolutions. Clients get the coarsest level
+            // first and fetch finer ones as far as their on-screen size needs them.
+            Image& enablePyramid();
+            // Sends the levels of the pyramid in tiles, of which clients fetch only the ones in
+            // view. Meant for images too large to be held by a browser at full resolution.
+            Image& enableTiling();
+
             int getWidth() const noexcept;
             int getHeight() const noexcept;
             Format getFormat() const noexcept;
-            uint8_t* getBuffer() const noexcept;
+            size_t getStride() const noexcept;
+            uint8_t const* getBuffer() const noexcept;
+            uint8_t* getBuffer();
             ImageImpl* getImpl() const noexcept;
 
             Image& operator =( Image const& _image_impl ) = default;
             Image& operator =( Image&& _image_impl ) = default;
 
         private:
+            Image( std::shared_ptr< ImageImpl > const& _pimpl );
+
             std::shared_ptr< ImageImpl > pimpl;
     };
 
@@ -73,9 +143,15 @@ namespace sdviz
             Canvas( Canvas&& _canvas ) = default;
             ~Canvas() = default;
 
+            // Copies the pixels unless the image is frozen.
             void drawImage( Image const& _image,
                             value_type const& _lt,
                             double _opacity = 1.0 );
+            // Takes the pixels over without a copy, unless they are in a raw buffer passed by
+            // pointer and the image is not frozen.
+            void drawImage( Image&& _image,
+                            value_type const& _lt,
+                            double _opacity = 1.0 );
             void drawRect( value_type const& _lt,
                            value_type const& _rb,
                            color_type color = color_type{ 0x00, 0x00, 0x00 },
@@ -108,6 +184,8 @@ namespace sdviz
             int getWidth() const noexcept;
             int getHeight() const noexcept;
             CanvasImpl* getImpl() const noexcept;
+            // Whether another copy of this canvas draws on the same commands.
+            bool isShared() const noexcept;
 
             Canvas& operator =( Canvas const& _canvas ) = default;
             Canvas& operator =( Canvas&& _canvas ) = default;
@@ -128,6 +206,35 @@ namespace sdviz
         drawLine( points, _color, _line_width, _fill, _with_dots );
     }
 
+    // Elements are referred to by small integers, which are also what goes over the wire.
+    using element_id_type = uint32_t;
+
+    // Keeps an element alive. All handles of an element share its holder, containers hold the
+    // holders of their children and the page those of its rows. The element is deleted once
+    // its last holder is gone, or right away when it is removed.
+    class ElementHolder final
+    {
+        public:
+            ElementHolder( element_id_type const _id, size_t const _lane );
+            ElementHolder( ElementHolder const& ) = delete;
+            ElementHolder( ElementHolder&& ) = delete;
+            ~ElementHolder();
+
+            ElementHolder& operator =( ElementHolder const& ) = delete;
+            ElementHolder& operator =( ElementHolder&& ) = delete;
+
+            void addChild( std::shared_ptr< ElementHolder > const& _child );
+            void remove();
+
+            element_id_type const id;
+
+        private:
+            size_t const lane;
+            std::atomic< bool > is_removed;
+            std::vector< std::shared_ptr< ElementHolder > > children;
+            std::mutex children_mutex;
+    };
+
     template< typename ValueType, typename ParamType >
     class Element final
     {
@@ -135,9 +242,18 @@ namespace sdviz
             using value_type = ValueType;
             using param_type = ParamType;
 
+            // The rvalue overloads move the value into the queued action instead of copying it.
             static Element create( value_type const& _value, param_type const& _param = param_type{} );
-            void setValue( value_type const& _value );
+            static Element create( value_type&& _value, param_type const& _param = param_type{} );
+            bool setValue( value_type const& _value );
+            bool setValue( value_type&& _value );
+            // Completes once the value, and everything set before it, has been sent to the clients
+            // connected by then. Fails when the action queue rejects the value.
+            std::future< void > setValueAsync( value_type const& _value );
+            std::future< void > setValueAsync( value_type&& _value );
             void setParam( param_type const& _param );
+            // Deletes the element even though other handles or containers still refer to it.
+            void remove();
 
             Element( Element const& _element ) = default;
             Element( Element&& _element ) = default;
@@ -146,9 +262,14 @@ namespace sdviz
             Element& operator =( Element const& _element ) = default;
             Element& operator =( Element&& _element ) = default;
 
-            std::string const id;
+            element_id_type const id;
         private:
-            Element( std::string const& _id );
+            friend class ContainerElement;
+            friend class Page;
+
+            Element( std::shared_ptr< ElementHolder > const& _holder );
+
+            std::shared_ptr< ElementHolder > holder;
     };
 
     struct TextElementParam final
@@ -158,6 +279,9 @@ namespace sdviz
 
     struct CanvasElementParam final
     {
+        // Upper bound of canvas updates sent to clients per second. Updates exceeding it are merged
+        // and the latest one is sent when the window ends. 0 means unlimited.
+        double max_fps = 0.0;
     };
     using CanvasElement = Element< Canvas, CanvasElementParam >;
 
@@ -172,6 +296,8 @@ namespace sdviz
 
         Type type;
         std::map< std::string, std::string > value_map;
+        // Upper bound of chart updates sent to clients per second. 0 means unlimited.
+        double max_hz = 0.0;
     };
     using ChartElement = Element< std::map< std::string, std::vector< double > >, ChartElementParam >;
 
@@ -179,6 +305,9 @@ namespace sdviz
     {
         std::string label;
         std::function< void( bool, bool ) > on_value_changed = []( bool, bool ){};
+        // Merge values arriving while the previous callback is still running, so that the
+        // callback gets the value it saw last and the newest one only.
+        bool coalesce_inbound = false;
     };
     using ButtonElement = Element< bool, ButtonElementParam >;
 
@@ -186,6 +315,9 @@ namespace sdviz
     {
         std::string label;
         std::function< void( double, double ) > on_value_changed = []( double, double ){};
+        // Merge values arriving while the previous callback is still running, so that the
+        // callback gets the value it saw last and the newest one only.
+        bool coalesce_inbound = false;
     };
     using SliderElement = Element< double, SliderElementParam >;
 
@@ -204,17 +336,24 @@ namespace sdviz
             template< typename ValueType, typename ParamType >
             ContainerElement& operator <<( Element< ValueType, ParamType > const& _element )
             {
-                addElement( _element.id );
+                addElement( _element.holder );
                 return *this;
             }
 
-            std::string const id;
+            // Deletes the container even though other handles or containers still refer to it.
+            void remove();
+
+            element_id_type const id;
             std::string const label;
             bool const _is_row_direction;
 
         protected:
-            ContainerElement( std::string const& _id, std::string const& _label, bool _is_row_direction );
-            void addElement( std::string const& _id );
+            friend class Page;
+
+            ContainerElement( std::shared_ptr< ElementHolder > const& _holder, std::string const& _label, bool _is_row_direction );
+            void addElement( std::shared_ptr< ElementHolder > const& _child );
+
+            std::shared_ptr< ElementHolder > holder;
     };
 
     class Page
@@ -229,13 +368,13 @@ namespace sdviz
             {
                 auto container = sdviz::ContainerElement::create();
                 container << _element;
-                addElement( container.id );
+                addElement( container.holder );
                 return *this;
             }
 
             Page& operator <<( ContainerElement const& _container )
             {
-                addElement( _container.id );
+                addElement( _container.holder );
                 return *this;
             }
 
@@ -247,8 +386,10 @@ namespace sdviz
 
         private:
             Page();
-            void addElement( std::string const& _id );
+            void addElement( std::shared_ptr< ElementHolder > const& _holder );
+            void addElement( element_id_type const _id );
             int span;
+            std::vector< std::shared_ptr< ElementHolder > > holders;
     };
     static auto& endl =  Page::endl;
     static auto& setw =  Page::setw;
@@ -257,6 +398,8 @@ namespace sdviz
     bool start( Config const& _config = Config{} );
     void wait();
     void stop();
+    // Blocks until every action issued so far has been processed and sent to the connected clients.
+    void flush();
 }
 
 #endif // _SDVIZ_HPP_
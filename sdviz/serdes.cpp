@@ -1,3 +1,8 @@
+#include <vector>
+#include <algorithm>
+
+#include <lz4.h>
+
 #include "./serdes.hpp"
 
 using namespace sdviz;
@@ -9,8 +14,147 @@ namespace
         return ( 0 < _obj.count("type") )
             && ( 0 < _obj.count("value") )
             && ( 0 < _obj.count("id") )
+            && _obj.at("id").is_number()
             && _obj.at("type").is_uint8();
     }
+
+    bool isValidFrameRequestObject( intermediate_map_type const& _obj )
+    {
+        auto const tile_it = _obj.find( "tile" );
+        bool const is_valid_tile = ( tile_it == std::end( _obj ) )
+            || ( tile_it->second.is_array()
+                 && ( tile_it->second.array_items().size() == 2 )
+                 && tile_it->second[0].is_number()
+                 && tile_it->second[1].is_number() );
+        return is_valid_tile
+            && ( 0 < _obj.count("level") )
+            && ( 0 < _obj.count("frame") )
+            && ( 0 < _obj.count("version") )
+            && ( 0 < _obj.count("id") )
+            && _obj.at("id").is_number()
+            && _obj.at("level").is_number()
+            && _obj.at("frame").is_number()
+            && _obj.at("version").is_number();
+    }
+
+    // Image frame layout, little endian:
+    //   0 : uint8  magic ( 0xc1, a byte msgpack never emits )
+    //   1 : uint8  image format
+    //   2 : uint8  pyramid level, 0 for full resolution
+    //   3 : uint8  1 for a tile of the level, 0 for the whole level
+    //   4 : uint32 element id
+    //   8 : uint32 element version
+    //  12 : uint32 canvas command index
+    //  16 : uint32 width
+    //  20 : uint32 height
+    //  24 : uint32 tile column
+    //  28 : uint32 tile row
+    //  32 : the tightly packed pixels as a sequence of LZ4 blocks, each preceded by its
+    //       uint32 compressed size. The blocks form one LZ4 stream, so a block may refer
+    //       back to the pixels of the previous ones.
+    uint8_t const image_frame_magic = 0xc1;
+    size_t const image_frame_header_size = 32;
+
+    void writeLittleEndian( serialized_type& _buffer, size_t const _offset, uint32_t const _value, size_t const _bytes )
+    {
+        for( size_t i = 0; i < _bytes; ++i )
+        {
+            _buffer[ _offset + i ] = static_cast< char >( ( _value >> ( 8 * i ) ) & 0xff );
+        }
+    }
+}
+
+// A packed image is compressed as one block. A strided one is compressed row by row straight
+// from its buffer, with the stream carrying the previous row over as dictionary, so the
+// padding is skipped without repacking the pixels first. Rows which need converting to the
+// wire format go through two alternating row buffers, which keeps the previous row intact.
+serialized_type sdviz::encodeImageFrame( element_id_type const _target_id,
+                                         int const _version,
+                                         int const _command_index,
+                                         ImageImpl const& _image,
+                                         ImageImpl::value_range_type const& _value_range,
+                                         int const _level,
+                                         int const _tile_column,
+                                         int const _tile_row )
+{
+    bool const is_tile = ( 0 <= _tile_column ) && ( 0 <= _tile_row );
+    PixelConverter const converter( _image, _value_range );
+    int const height = _image.getHeight();
+    int const rows_per_block = ( _image.isPacked() && converter.isIdentity() ) ? std::max( height, 1 ) : 1;
+    int const block_size = rows_per_block * converter.getRowSize();
+    int const block_count = ( height + rows_per_block - 1 ) / rows_per_block;
+    auto const compressed_block_bound = LZ4_compressBound( block_size );
+    size_t const payload_offset = image_frame_header_size;
+
+    serialized_type frame( payload_offset + block_count * ( 4 + compressed_block_bound ), '\0' );
+    writeLittleEndian( frame, 0, image_frame_magic, 1 );
+    writeLittleEndian( frame, 1, PixelConverter::GetWireFormat( _image.getFormat() ), 1 );
+    writeLittleEndian( frame, 2, _level, 1 );
+    writeLittleEndian( frame, 3, is_tile ? 1 : 0, 1 );
+    writeLittleEndian( frame, 4, _target_id, 4 );
+    writeLittleEndian( frame, 8, _version, 4 );
+    writeLittleEndian( frame, 12, _command_index, 4 );
+    writeLittleEndian( frame, 16, _image.getWidth(), 4 );
+    writeLittleEndian( frame, 20, _image.getHeight(), 4 );
+    writeLittleEndian( frame, 24, is_tile ? _tile_column : 0, 4 );
+    writeLittleEndian( frame, 28, is_tile ? _tile_row : 0, 4 );
+
+    std::vector< uint8_t > converted_rows( converter.isIdentity() ? 0 : 2 * block_size );
+    LZ4_stream_t stream;
+    LZ4_resetStream( &stream );
+    size_t block_offset = payload_offset;
+    for( int row = 0; row < height; row += rows_per_block )
+    {
+        uint8_t const* source = _image.getBuffer() + row * _image.getStride();
+        if( !converter.isIdentity() )
+        {
+            uint8_t* const converted_row = &converted_rows[ ( row % 2 ) * block_size ];
+            converter.convertRow( source, converted_row );
+            source = converted_row;
+        }
+
+        auto const block = reinterpret_cast< const char* >( source );
+        int const compressed_block_size = LZ4_compress_fast_continue( &stream,
+                                                                      block,
+                                                                      &frame[ block_offset + 4 ],
+                                                                      block_size,
+                                                                      compressed_block_bound,
+                                                                      1 );
+        writeLittleEndian( frame, block_offset, compressed_block_size, 4 );
+        block_offset += 4 + compressed_block_size;
+    }
+    frame.resize( block_offset );
+    return frame;
+}
+
+void sdviz::collectFrameHandles( intermediate_type const& _intermediate, std::set< int >& _handles )
+{
+    if( _intermediate.is_array() )
+    {
+        for( auto const& item : _intermediate.array_items() )
+        {
+            collectFrameHandles( item, _handles );
+        }
+        return;
+    }
+
+    if( !_intermediate.is_object() )
+    {
+        return;
+    }
+
+    auto const& obj = _intermediate.object_items();
+    auto const frame_it = obj.find( "frame" );
+    if( frame_it != std::end( obj ) )
+    {
+        _handles.insert( frame_it->second.int_value() );
+        return;
+    }
+
+    for( auto const& key_value : obj )
+    {
+        collectFrameHandles( key_value.second, _handles );
+    }
 }
 
 bool sdviz::isValid( intermediate_type const& _intermediate )
@@ -35,6 +179,131 @@ intermediate_type sdviz::deserialize( serialized_type const& _serialize )
     return msgpack;
 }
 
+// Encodes the header of a msgpack array, to be followed by its already serialized items.
+serialized_type sdviz::encodeArrayHeader( size_t const _count )
+{
+    serialized_type header;
+    if( _count < 16 )
+    {
+        header.push_back( static_cast< char >( 0x90 | _count ) );
+    }
+    else if( _count < 0x10000 )
+    {
+        header.push_back( static_cast< char >( 0xdc ) );
+        header.push_back( static_cast< char >( ( _count >> 8 ) & 0xff ) );
+        header.push_back( static_cast< char >( _count & 0xff ) );
+    }
+    else
+    {
+        header.push_back( static_cast< char >( 0xdd ) );
+        for( int shift = 24; 0 <= shift; shift -= 8 )
+        {
+            header.push_back( static_cast< char >( ( _count >> shift ) & 0xff ) );
+        }
+    }
+
+    return header;
+}
+
+SerializedUpdate::SerializedUpdate( ElementUpdate const& _update )
+    : update( _update )
+{
+    std::set< int > handles;
+    collectFrameHandles( update.delta, handles );
+    for( auto const handle : handles )
+    {
+        auto const frame_it = update.frames.find( handle );
+        if( frame_it != std::end( update.frames ) )
+        {
+            delta_frames.emplace_back( frame_it->second );
+        }
+    }
+}
+
+element_id_type SerializedUpdate::getTargetId() const noexcept
+{
+    return update.target_id;
+}
+
+int SerializedUpdate::getVersion() const noexcept
+{
+    return update.version;
+}
+
+Lane SerializedUpdate::getLane() const noexcept
+{
+    return update.lane;
+}
+
+bool SerializedUpdate::hasDelta() const noexcept
+{
+    return !update.delta.is_null();
+}
+
+bool SerializedUpdate::isRemoval() const noexcept
+{
+    return update.is_removal;
+}
+
+bool SerializedUpdate::isFrameOnly() const noexcept
+{
+    return update.is_frame_only;
+}
+
+SerializedUpdate::buffer_array_type SerializedUpdate::getBuffers( bool const _use_delta ) const
+{
+    buffer_array_type buffers;
+    if( _use_delta )
+    {
+        buffers.assign( std::begin( delta_frames ), std::end( delta_frames ) );
+    }
+    else
+    {
+        auto const& frames = getFullFrames();
+        std::transform( std::begin( frames ),
+                        std::end( frames ),
+                        std::back_inserter( buffers ),
+                        []( auto const& _handle_frame ){ return std::get<1>( _handle_frame ); } );
+    }
+
+    if( !update.is_frame_only )
+    {
+        buffers.emplace_back( getMessage( _use_delta ) );
+    }
+    return buffers;
+}
+
+// Starts from the frames encoded for the delta, which are the same for the full form.
+frame_map_type const& SerializedUpdate::getFullFrames() const
+{
+    std::call_once( full_frames_flag, [this](){
+        full_frames = update.frames;
+        if( update.encode_frames )
+        {
+            std::set< int > handles;
+            collectFrameHandles( update.full, handles );
+            update.encode_frames( handles, full_frames );
+        }
+    });
+    return full_frames;
+}
+
+std::shared_ptr< serialized_type const > SerializedUpdate::getMessage( bool const _use_delta ) const
+{
+    if( _use_delta )
+    {
+        std::call_once( delta_flag, [this](){
+            delta_buffer = std::make_shared< serialized_type const >( serialize( update.delta ) );
+        });
+        return delta_buffer;
+    }
+
+    std::call_once( full_flag, [this](){
+        full_buffer = std::make_shared< serialized_type const >( serialize( update.full ) );
+    });
+    return full_buffer;
+}
+
 ActionVariant sdviz::intermediateTypeToSetValueAction( intermediate_type const& _intermediate_action )
 {
     if( !_intermediate_action.is_object() )
@@ -48,7 +317,7 @@ ActionVariant sdviz::intermediateTypeToSetValueAction( intermediate_type const&
         throw std::runtime_error( "Intermediate object has invalid format." );
     }
 
-    std::string const target_id = obj["id"].string_value();
+    element_id_type const target_id = obj["id"].uint32_value();
     int const type_index = obj["type"].int_value();
     switch (type_index) {
         case GetVariantTypeIndex< ElementImplVariant, ButtonElementImpl >::value:
@@ -59,3 +328,28 @@ ActionVariant sdviz::intermediateTypeToSetValueAction( intermediate_type const&
 
     throw std::runtime_error( "Intermediate object has invalid type." );
 }
+
+bool sdviz::isFrameRequest( intermediate_type const& _intermediate_action )
+{
+    return _intermediate_action.is_object() && ( 0 < _intermediate_action.object_items().count( "level" ) );
+}
+
+ActionVariant sdviz::intermediateTypeToFrameRequestAction( intermediate_type const& _intermediate_action, std::string const& _connection_id )
+{
+    intermediate_map_type obj = _intermediate_action.object_items();
+    if( !isValidFrameRequestObject( obj ) )
+    {
+        throw std::runtime_error( "Intermediate object has invalid format." );
+    }
+
+    element_id_type const target_id = obj["id"].uint32_value();
+    bool const is_tile = ( 0 < obj.count( "tile" ) );
+    FrameRequest request{ _connection_id,
+                          obj["version"].int_value(),
+                          obj["frame"].int_value(),
+                          obj["level"].int_value(),
+                          is_tile,
+                          is_tile ? obj["tile"][0].int_value() : 0,
+                          is_tile ? obj["tile"][1].int_value() : 0 };
+    return ActionVariant{ FrameRequestAction{ target_id, std::move( request ) } };
+}
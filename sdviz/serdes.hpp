@@ -2,13 +2,23 @@
 # define __SDVIZ_SERDES_HPP__
 
 # include <string>
+# include <map>
+# include <functional>
+# include <memory>
+# include <mutex>
+# include <set>
+# include <vector>
+# include <iterator>
+# include <algorithm>
 # include <stdexcept>
 
 # include <msgpack11.hpp>
-# include <lz4.h>
 
 # include "./action.hpp"
 # include "./image_impl.hpp"
+# include "./image_pyramid.hpp"
+# include "./pixel_convert.hpp"
+# include "./tile_cache.hpp"
 # include "./canvas_impl.hpp"
 # include "./layout_impl.hpp"
 # include "./element_impl.hpp"
@@ -24,9 +34,25 @@ namespace sdviz
     bool isValid( intermediate_type const& _intermediate );
     serialized_type serialize( intermediate_type const& _intermediate );
     intermediate_type deserialize( serialized_type const& _serialize );
+    serialized_type encodeArrayHeader( size_t const _count );
+
+    // Pixel payloads travel as raw binary frames sent just before the message referring to them.
+    // A frame is keyed by element id, element version and canvas command index; the message
+    // carries the command index as the frame handle. See encodeImageFrame for the layout.
+    using frame_ptr_type = std::shared_ptr< serialized_type const >;
+    using frame_map_type = std::map< int, frame_ptr_type >;
+
+    serialized_type encodeImageFrame( element_id_type const _target_id,
+                                      int const _version,
+                                      int const _command_index,
+                                      ImageImpl const& _image,
+                                      ImageImpl::value_range_type const& _value_range,
+                                      int const _level = 0,
+                                      int const _tile_column = -1,
+                                      int const _tile_row = -1 );
+    void collectFrameHandles( intermediate_type const& _intermediate, std::set< int >& _handles );
 
     template< typename T > struct ValueConvertedTypeTraits { using type = T; };
-    template<> struct ValueConvertedTypeTraits< ImageImpl > { using type = intermediate_type; };
     template<> struct ValueConvertedTypeTraits< CanvasImpl > { using type = intermediate_type; };
     template<> struct ValueConvertedTypeTraits< LayoutImpl > { using type = intermediate_type; };
 
@@ -36,53 +62,68 @@ namespace sdviz
         return _value;
     }
 
-    template<>
-    inline typename ValueConvertedTypeTraits< ImageImpl >::type valueToIntermediateType<ImageImpl>( ImageImpl const& _image )
-    {
-        auto const image_size = ImageImpl::GetBufferSize( _image );
-        auto const compressed_image_bound = LZ4_compressBound( image_size );
-        std::vector<uint8_t> compressed_image( compressed_image_bound );
-        int const compressed_image_size = LZ4_compress_default( reinterpret_cast< const char*>( _image.getBuffer() ),
-                                                                reinterpret_cast< char*>( compressed_image.data() ),
-                                                                image_size,
-                                                                compressed_image_bound );
-        compressed_image.erase( std::begin( compressed_image ) + compressed_image_size, std::end( compressed_image ) );
-
-        return intermediate_map_type{
-            { "buffer", compressed_image },
-            { "width", _image.getWidth() },
-            { "height", _image.getHeight() },
-            { "format", _image.getFormat() }
-        };
-    }
-
     template< typename T, size_t... I >
     intermediate_array_type tupleToIntermediateArrayImpl( T&& _tuple, std::index_sequence<I...> )
     {
         return intermediate_array_type{ valueToIntermediateType( std::get<I>( _tuple ) )... };
     }
 
-    template< typename T, typename Indices = std::make_index_sequence< std::tuple_size<T>::value > >
+    template< typename T, typename Indices = std::make_index_sequence< std::tuple_size< std::decay_t<T> >::value > >
     intermediate_array_type tupleToIntermediateArray( T&& _tuple )
     {
         return tupleToIntermediateArrayImpl( std::forward<T>( _tuple ), Indices() );
     }
 
-    template<>
-    inline typename ValueConvertedTypeTraits< CanvasImpl >::type valueToIntermediateType<CanvasImpl>( CanvasImpl const& _canvas )
+    template< typename CommandType >
+    inline intermediate_array_type canvasCommandArgsToIntermediateType( CommandType const& _command, int const )
+    {
+        return tupleToIntermediateArray( _command.getParam() );
+    }
+
+    inline intermediate_array_type canvasCommandArgsToIntermediateType( CanvasImpl::ImageCommand const& _command, int const _index )
     {
-        auto visitor = makeVariantVisitor< intermediate_type >( []( auto const& command ){
+        auto const& param = _command.getParam();
+        auto const& image = std::get<0>( param );
+        intermediate_map_type image_handle{
+            { "frame", _index },
+            { "width", image.getWidth() },
+            { "height", image.getHeight() },
+            { "format", PixelConverter::GetWireFormat( image.getFormat() ) },
+            { "levels", image.getLevelCount() }
+        };
+        if( image.isTiled() )
+        {
+            image_handle.emplace( "tile_size", ImagePyramid::tile_size );
+        }
+
+        return intermediate_array_type{
+            image_handle,
+            std::get<1>( param ),
+            std::get<2>( param ),
+            std::get<3>( param )
+        };
+    }
+
+    inline intermediate_type canvasCommandToIntermediateType( CanvasImpl::CanvasCommandVariant const& _command, int const _index )
+    {
+        auto visitor = makeVariantVisitor< intermediate_type >( [_index]( auto const& command ){
             return intermediate_map_type{
                 { "func", command.func_name },
-                { "args", tupleToIntermediateArray( command.getParam() ) }
+                { "args", canvasCommandArgsToIntermediateType( command, _index ) }
             };
         });
 
+        return boost::apply_visitor( visitor, _command );
+    }
+
+    template<>
+    inline typename ValueConvertedTypeTraits< CanvasImpl >::type valueToIntermediateType<CanvasImpl>( CanvasImpl const& _canvas )
+    {
         intermediate_array_type commands;
-        std::transform( _canvas.cbegin(),
-                        _canvas.cend(),
-                        std::back_inserter( commands ),
-                        [&]( auto const& command ){ return boost::apply_visitor( visitor, command ); });
+        for( auto command_it = _canvas.cbegin(); command_it != _canvas.cend(); ++command_it )
+        {
+            commands.emplace_back( canvasCommandToIntermediateType( *command_it, commands.size() ) );
+        }
         return intermediate_map_type{
             { "commands", commands },
             { "width", _canvas.getWidth() },
@@ -90,6 +131,14 @@ namespace sdviz
         };
     }
 
+    inline intermediate_type layoutEntryToIntermediateType( LayoutImpl::value_type const& _entry, int const = 0 )
+    {
+        return intermediate_map_type{
+            { "span", std::get<0>( _entry ) },
+            { "id", std::get<1>( _entry ) }
+        };
+    }
+
     template<>
     inline typename ValueConvertedTypeTraits< LayoutImpl >::type valueToIntermediateType<LayoutImpl>( LayoutImpl const& _layout )
     {
@@ -97,16 +146,161 @@ namespace sdviz
         std::transform( std::begin( _layout ),
                         std::end( _layout ),
                         std::back_inserter( result ),
-                        []( auto const& _element ){
-                            return intermediate_map_type{
-                                { "span", std::get<0>( _element ) },
-                                { "id", std::get<1>( _element ) }
-                            };
-        });
+                        []( auto const& _entry ){ return layoutEntryToIntermediateType( _entry ); } );
 
         return result;
     }
 
+    // A value patch turns the value a client holds at the previous version into the current one.
+    // "set" overwrites entries by key ( or index ), "erase" drops keys, "length" truncates arrays
+    // and "nested" carries patches for members which are themselves collections.
+    // A null patch means the value has to be sent as a whole.
+    template< typename T >
+    inline intermediate_type valueToIntermediatePatch( T const&, T const& )
+    {
+        return intermediate_type{};
+    }
+
+    template< typename IteratorType, typename ConvertFunc, typename EqualFunc = std::equal_to<> >
+    intermediate_type arrayToIntermediatePatch( IteratorType _current_begin,
+                                                IteratorType _current_end,
+                                                IteratorType _next_begin,
+                                                IteratorType _next_end,
+                                                ConvertFunc _convert,
+                                                EqualFunc _is_equal = EqualFunc{} )
+    {
+        intermediate_map_type set;
+        int length = 0;
+        for( auto next_it = _next_begin; next_it != _next_end; ++next_it, ++length )
+        {
+            bool const is_changed = ( _current_begin == _current_end ) || !_is_equal( *_current_begin, *next_it );
+            if( is_changed )
+            {
+                set.emplace( length, _convert( *next_it, length ) );
+            }
+
+            if( _current_begin != _current_end )
+            {
+                ++_current_begin;
+            }
+        }
+
+        return intermediate_map_type{
+            { "set", set },
+            { "length", length }
+        };
+    }
+
+    template<>
+    inline intermediate_type valueToIntermediatePatch< std::map< std::string, std::vector< double > > >( std::map< std::string, std::vector< double > > const& _current,
+                                                                                                         std::map< std::string, std::vector< double > > const& _next )
+    {
+        intermediate_map_type set;
+        for( auto const& key_value : _next )
+        {
+            auto const current_it = _current.find( key_value.first );
+            if( ( current_it == std::end( _current ) ) || ( current_it->second != key_value.second ) )
+            {
+                set.emplace( key_value.first, key_value.second );
+            }
+        }
+
+        intermediate_array_type erase;
+        for( auto const& key_value : _current )
+        {
+            if( _next.count( key_value.first ) == 0 )
+            {
+                erase.emplace_back( key_value.first );
+            }
+        }
+
+        return intermediate_map_type{
+            { "set", set },
+            { "erase", erase }
+        };
+    }
+
+    // Images count as unchanged only when they share their pixels, comparing the pixels
+    // themselves would cost as much as a frame for every image on every update.
+    inline bool isSameCanvasCommand( CanvasImpl::CanvasCommandVariant const& _current, CanvasImpl::CanvasCommandVariant const& _next )
+    {
+        auto const current_image = boost::get< CanvasImpl::ImageCommand >( &_current );
+        auto const next_image = boost::get< CanvasImpl::ImageCommand >( &_next );
+        if( !current_image || !next_image )
+        {
+            return _current == _next;
+        }
+
+        auto const& current_param = current_image->getParam();
+        auto const& next_param = next_image->getParam();
+        auto const& current = std::get<0>( current_param );
+        auto const& next = std::get<0>( next_param );
+        return current.sharesPixelsWith( next )
+               && ( current.getLevelCount() == next.getLevelCount() )
+               && ( current.isTiled() == next.isTiled() )
+               && ( std::get<1>( current_param ) == std::get<1>( next_param ) )
+               && ( std::get<2>( current_param ) == std::get<2>( next_param ) )
+               && ( std::get<3>( current_param ) == std::get<3>( next_param ) );
+    }
+
+    template<>
+    inline intermediate_type valueToIntermediatePatch< CanvasImpl >( CanvasImpl const& _current, CanvasImpl const& _next )
+    {
+        auto const commands_patch = arrayToIntermediatePatch( _current.cbegin(),
+                                                              _current.cend(),
+                                                              _next.cbegin(),
+                                                              _next.cend(),
+                                                              canvasCommandToIntermediateType,
+                                                              isSameCanvasCommand );
+        return intermediate_map_type{
+            { "set", intermediate_map_type{
+                { "width", _next.getWidth() },
+                { "height", _next.getHeight() }
+            } },
+            { "nested", intermediate_map_type{
+                { "commands", commands_patch }
+            } }
+        };
+    }
+
+    template<>
+    inline intermediate_type valueToIntermediatePatch< LayoutImpl >( LayoutImpl const& _current, LayoutImpl const& _next )
+    {
+        return arrayToIntermediatePatch( std::begin( _current ),
+                                         std::end( _current ),
+                                         std::begin( _next ),
+                                         std::end( _next ),
+                                         layoutEntryToIntermediateType );
+    }
+
+    // Adds to _frames those of the image commands indexed by _handles it does not hold yet.
+    template< typename T >
+    inline void valueToFrames( element_id_type const, int const, T const&, std::set< int > const&, frame_map_type& )
+    {
+    }
+
+    template<>
+    inline void valueToFrames< CanvasImpl >( element_id_type const _target_id,
+                                             int const _version,
+                                             CanvasImpl const& _canvas,
+                                             std::set< int > const& _handles,
+                                             frame_map_type& _frames )
+    {
+        int command_index = 0;
+        for( auto command_it = _canvas.cbegin(); command_it != _canvas.cend(); ++command_it, ++command_index )
+        {
+            auto const image_command = boost::get< CanvasImpl::ImageCommand >( &( *command_it ) );
+            if( image_command && ( 0 < _handles.count( command_index ) ) && ( 0 == _frames.count( command_index ) ) )
+            {
+                auto const& param = image_command->getParam();
+                auto const& image = std::get<0>( param );
+                int const level = image.getLevelCount() - 1;
+                auto frame = encodeImageFrame( _target_id, _version, command_index, image.getLevel( level ), image.getValueRange(), level );
+                _frames.emplace( command_index, std::make_shared< serialized_type const >( std::move( frame ) ) );
+            }
+        }
+    }
+
     template< typename ParamType >
     inline intermediate_type paramToIntermediateType( ParamType const& )
     {
@@ -148,7 +342,7 @@ namespace sdviz
     }
 
     template< typename ElementImplType >
-    inline intermediate_type elementImplToIntermediateType( std::string const& _target_id, ElementImplType const& _element )
+    inline intermediate_type elementImplToIntermediateType( element_id_type const _target_id, ElementImplType const& _element )
     {
         auto const& value = _element.getValue();
         auto const intermediate_value = valueToIntermediateType( value );
@@ -169,7 +363,80 @@ namespace sdviz
         };
     }
 
-    inline intermediate_type elementImplToIntermediateType( std::string const& _target_id, ElementImplVariant const& _element_impl_variant )
+    // An element update carries the full element and, when the element has been synced before,
+    // a delta holding only the part changed since the previous version ( version - 1 ).
+    // Frames hold the pixel payloads the delta refers to, those only the full form refers to
+    // are left to encode_frames until a session needs the full form. A frame only update
+    // carries just a frame a client asked for, such as a finer level of an image pyramid.
+    using frame_encoder_type = std::function< void( std::set< int > const&, frame_map_type& ) >;
+    struct ElementUpdate
+    {
+        element_id_type target_id;
+        int version;
+        intermediate_type full;
+        intermediate_type delta;
+        frame_map_type frames;
+        Lane lane;
+        bool is_removal;
+        bool is_frame_only;
+        frame_encoder_type encode_frames;
+    };
+    using element_update_array_type = std::vector< ElementUpdate >;
+
+    // Encodes the frames of the snapshot, which the encoder keeps alive for as long as the
+    // update may still need them.
+    template< typename ElementImplType >
+    inline frame_encoder_type makeFrameEncoder( element_id_type const _target_id, std::shared_ptr< ElementImplType const > const& _element )
+    {
+        return [_target_id, _element]( std::set< int > const& _handles, frame_map_type& _frames ){
+            valueToFrames( _target_id, _element->getVersion(), _element->getValue(), _handles, _frames );
+        };
+    }
+
+    // Only the frames of the images the delta refers to are encoded up front, so an update
+    // leaving images as they were or changing just the param compresses none of them.
+    template< typename ElementImplType >
+    inline ElementUpdate elementImplToUpdate( element_id_type const _target_id,
+                                              std::shared_ptr< ElementImplType const > const& _element,
+                                              intermediate_type const& _value_patch = intermediate_type{} )
+    {
+        intermediate_type const full = elementImplToIntermediateType( _target_id, *_element );
+
+        int const version = _element->getVersion();
+        auto const encode_frames = makeFrameEncoder( _target_id, _element );
+        if( version == 0 )
+        {
+            return ElementUpdate{ _target_id, version, full, intermediate_type{}, frame_map_type{}, ElementLane< ElementImplType >::value, false, false, encode_frames };
+        }
+
+        intermediate_map_type delta{
+            { "id", _target_id },
+            { "type", full[ "type" ] },
+            { "version", version },
+            { "base_version", version - 1 }
+        };
+        if( _element->getParamVersion() == version )
+        {
+            delta.emplace( "param", full[ "param" ] );
+        }
+        else if( _value_patch.is_null() )
+        {
+            delta.emplace( "value", full[ "value" ] );
+        }
+        else
+        {
+            delta.emplace( "value_patch", _value_patch );
+        }
+
+        std::set< int > delta_handles;
+        collectFrameHandles( delta, delta_handles );
+        frame_map_type frames;
+        encode_frames( delta_handles, frames );
+
+        return ElementUpdate{ _target_id, version, full, delta, frames, ElementLane< ElementImplType >::value, false, false, encode_frames };
+    }
+
+    inline intermediate_type elementImplToIntermediateType( element_id_type const _target_id, ElementImplVariant const& _element_impl_variant )
     {
         auto visitor = makeVariantVisitor< intermediate_type >([&_target_id]( auto const& _element_impl ){
             return elementImplToIntermediateType( _target_id, _element_impl );
@@ -178,7 +445,182 @@ namespace sdviz
         return boost::apply_visitor( visitor, _element_impl_variant );
     }
 
+    template< typename ElementImplType >
+    inline ElementUpdate elementImplToFullUpdate( element_id_type const _target_id, std::shared_ptr< ElementImplType const > const& _element )
+    {
+        return ElementUpdate{ _target_id,
+                              _element->getVersion(),
+                              elementImplToIntermediateType( _target_id, *_element ),
+                              intermediate_type{},
+                              frame_map_type{},
+                              ElementLane< ElementImplType >::value,
+                              false,
+                              false,
+                              makeFrameEncoder( _target_id, _element ) };
+    }
+
+    // An element update shared by all sessions. Its full and delta forms, and the frames only
+    // the full form refers to, are serialized at most once, by whichever session needs them
+    // first. Each form goes out as the image frames it refers to followed by the message
+    // itself, a frame only update as its frames.
+    class SerializedUpdate final
+    {
+        public:
+            using buffer_array_type = std::vector< std::shared_ptr< serialized_type const > >;
+
+            explicit SerializedUpdate( ElementUpdate const& _update );
+            SerializedUpdate( SerializedUpdate const& ) = delete;
+            SerializedUpdate( SerializedUpdate&& ) = delete;
+            ~SerializedUpdate() = default;
+
+            SerializedUpdate& operator =( SerializedUpdate const& ) = delete;
+            SerializedUpdate& operator =( SerializedUpdate&& ) = delete;
+
+            element_id_type getTargetId() const noexcept;
+            int getVersion() const noexcept;
+            Lane getLane() const noexcept;
+            bool hasDelta() const noexcept;
+            bool isRemoval() const noexcept;
+            bool isFrameOnly() const noexcept;
+            buffer_array_type getBuffers( bool const _use_delta ) const;
+
+        private:
+            std::shared_ptr< serialized_type const > getMessage( bool const _use_delta ) const;
+            frame_map_type const& getFullFrames() const;
+
+            ElementUpdate update;
+            std::vector< frame_ptr_type > delta_frames;
+            mutable std::once_flag full_flag;
+            mutable std::once_flag delta_flag;
+            mutable std::once_flag full_frames_flag;
+            mutable std::shared_ptr< serialized_type const > full_buffer;
+            mutable std::shared_ptr< serialized_type const > delta_buffer;
+            mutable frame_map_type full_frames;
+    };
+
+    using serialized_update_ptr_type = std::shared_ptr< SerializedUpdate const >;
+
+    // An update job encodes an immutable snapshot of an element, so it can run on any thread
+    // while the element store moves on. The result is cached by the element for its version.
+    using update_job_type = std::function< serialized_update_ptr_type() >;
+    using update_job_array_type = std::vector< update_job_type >;
+
+    template< typename ElementImplType >
+    inline update_job_type makeUpdateJob( element_id_type const _target_id,
+                                          ElementImplType const& _element,
+                                          std::shared_ptr< typename ElementImplType::value_type const > const& _previous_value = nullptr )
+    {
+        auto const snapshot = std::make_shared< ElementImplType const >( _element.snapshot() );
+        return [_target_id, snapshot, _previous_value](){
+            auto const value_patch = _previous_value ? valueToIntermediatePatch( *_previous_value, snapshot->getValue() )
+                                                     : intermediate_type{};
+            auto const update = std::make_shared< SerializedUpdate const >( elementImplToUpdate( _target_id, snapshot, value_patch ) );
+            snapshot->getEncodedCache().set( snapshot->getVersion(), update );
+            return update;
+        };
+    }
+
+    // Tells clients to drop an element.
+    inline ElementUpdate elementRemovalToUpdate( element_id_type const _target_id )
+    {
+        intermediate_type const full = intermediate_map_type{
+            { "id", _target_id },
+            { "removed", true }
+        };
+        return ElementUpdate{ _target_id, 0, full, intermediate_type{}, frame_map_type{}, ControlLane, true, false, nullptr };
+    }
+
+    inline update_job_type makeRemovalUpdateJob( element_id_type const _target_id )
+    {
+        return [_target_id](){
+            return std::make_shared< SerializedUpdate const >( elementRemovalToUpdate( _target_id ) );
+        };
+    }
+
+    // Encodes a level of the pyramid of an image drawn on a canvas, or a tile of it, as a frame
+    // only update. Tiles go through the tile cache, as many clients browse the same few.
+    inline update_job_type makeFrameUpdateJob( element_id_type const _target_id,
+                                               CanvasElementImpl const& _element,
+                                               FrameRequest const& _request )
+    {
+        auto const snapshot = std::make_shared< CanvasElementImpl const >( _element.snapshot() );
+        return [_target_id, snapshot, _request](){
+            auto const& command = *std::next( snapshot->getValue().cbegin(), _request.command_index );
+            auto const& image = std::get<0>( boost::get< CanvasImpl::ImageCommand >( command ).getParam() );
+            int const version = snapshot->getVersion();
+            TileCache::key_type const tile_key{ _target_id, version, _request.command_index, _request.level, _request.tile_column, _request.tile_row };
+
+            frame_ptr_type frame = _request.is_tile ? TileCache::getInstance().get( tile_key ) : nullptr;
+            if( !frame )
+            {
+                auto level = image.getLevel( _request.level );
+                if( _request.is_tile )
+                {
+                    int const x = _request.tile_column * ImagePyramid::tile_size;
+                    int const y = _request.tile_row * ImagePyramid::tile_size;
+                    level = level.getRegion( x,
+                                             y,
+                                             std::min( ImagePyramid::tile_size, level.getWidth() - x ),
+                                             std::min( ImagePyramid::tile_size, level.getHeight() - y ) );
+                    frame = std::make_shared< serialized_type const >( encodeImageFrame( _target_id,
+                                                                                         version,
+                                                                                         _request.command_index,
+                                                                                         level,
+                                                                                         image.getValueRange(),
+                                                                                         _request.level,
+                                                                                         _request.tile_column,
+                                                                                         _request.tile_row ) );
+                    TileCache::getInstance().put( tile_key, frame );
+                }
+                else
+                {
+                    frame = std::make_shared< serialized_type const >( encodeImageFrame( _target_id,
+                                                                                         version,
+                                                                                         _request.command_index,
+                                                                                         level,
+                                                                                         image.getValueRange(),
+                                                                                         _request.level ) );
+                }
+            }
+
+            return std::make_shared< SerializedUpdate const >( ElementUpdate{ _target_id,
+                                                                              version,
+                                                                              intermediate_type{},
+                                                                              intermediate_type{},
+                                                                              frame_map_type{ { _request.command_index, frame } },
+                                                                              ElementLane< CanvasElementImpl >::value,
+                                                                              false,
+                                                                              true,
+                                                                              nullptr } );
+        };
+    }
+
+    // Reuses the update cached for the current version, so resyncing an unchanged element costs
+    // neither serialization nor compression.
+    inline update_job_type makeFullUpdateJob( element_id_type const _target_id, ElementImplVariant const& _element_impl_variant )
+    {
+        auto visitor = makeVariantVisitor< update_job_type >([_target_id]( auto const& _element_impl ) -> update_job_type {
+            auto const cached = _element_impl.getEncodedCache().get( _element_impl.getVersion() );
+            if( cached )
+            {
+                return [cached](){ return cached; };
+            }
+
+            using element_impl_type = std::decay_t< decltype( _element_impl ) >;
+            auto const snapshot = std::make_shared< element_impl_type const >( _element_impl.snapshot() );
+            return [_target_id, snapshot](){
+                auto const update = std::make_shared< SerializedUpdate const >( elementImplToFullUpdate( _target_id, snapshot ) );
+                snapshot->getEncodedCache().set( snapshot->getVersion(), update );
+                return update;
+            };
+        });
+
+        return boost::apply_visitor( visitor, _element_impl_variant );
+    }
+
     ActionVariant intermediateTypeToSetValueAction( intermediate_type const& _intermediate_action );
+    bool isFrameRequest( intermediate_type const& _intermediate_action );
+    ActionVariant intermediateTypeToFrameRequestAction( intermediate_type const& _intermediate_action, std::string const& _connection_id );
 }
 
 #endif // __SDVIZ_SERDES_HPP__
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+#include "sync_session.hpp"
+
+using namespace sdviz;
+
+SyncSession::SyncSession( size_t const _max_queued_frames,
+                          size_t const _max_queued_bytes,
+                          size_t const _max_batch_updates,
+                          size_t const _max_batch_bytes )
+    : max_queued_frames( _max_queued_frames ),
+      max_queued_bytes( _max_queued_bytes ),
+      max_batch_updates( _max_batch_updates ),
+      max_batch_bytes( _max_batch_bytes ),
+      queued_bytes( 0 ),
+      is_writing( false )
+{
+}
+
+void SyncSession::push( update_ptr_type const& _update )
+{
+    std::lock_guard< std::mutex > lock( mutex );
+
+    auto const buffers = _update->getBuffers( isDeltaApplicable( _update ) );
+    size_t const bytes = std::accumulate( std::begin( buffers ),
+                                          std::end( buffers ),
+                                          size_t( 0 ),
+                                          []( size_t const _sum, auto const& _buffer ){ return _sum + _buffer->size(); } );
+    // Frames asked for by the client add to the element's queued update instead of replacing it.
+    auto const entry_it = _update->isFrameOnly() ? std::end( queued_entries ) : queued_entries.find( _update->getTargetId() );
+    if( entry_it != std::end( queued_entries ) )
+    {
+        auto& entry = *( entry_it->second );
+        queued_bytes = queued_bytes - entry.bytes + bytes;
+        entry = Entry{ _update, bytes, std::move( entry.fences ) };
+    }
+    else
+    {
+        auto& queue = queues[ _update->getLane() ];
+        queue.emplace_back( Entry{ _update, bytes, fence_array_type{} } );
+        if( !_update->isFrameOnly() )
+        {
+            queued_entries.emplace( _update->getTargetId(), std::prev( std::end( queue ) ) );
+        }
+        queued_bytes += bytes;
+    }
+
+    dropOverBudget();
+}
+
+void SyncSession::pushFence( fence_ptr_type const& _fence )
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    if( is_writing )
+    {
+        writing_fences.emplace_back( _fence );
+    }
+
+    for( auto& queue : queues )
+    {
+        for( auto& entry : queue )
+        {
+            entry.fences.emplace_back( _fence );
+        }
+    }
+}
+
+SyncSession::message_array_type SyncSession::next()
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    if( is_writing || isEmpty() )
+    {
+        return message_array_type{};
+    }
+
+    message_array_type buffers;
+    message_type messages;
+    size_t batch_updates = 0;
+    size_t batch_bytes = 0;
+    for( auto& queue : queues )
+    {
+        while( !queue.empty() && ( batch_updates < max_batch_updates ) )
+        {
+            auto& entry = queue.front();
+            if( ( 0 < batch_updates ) && ( max_batch_bytes < ( batch_bytes + entry.bytes ) ) )
+            {
+                break;
+            }
+
+            // A frame only update leaves the synced state of its element as it is.
+            bool const is_frame_only = entry.update->isFrameOnly();
+            bool const use_delta = isDeltaApplicable( entry.update );
+            if( !is_frame_only )
+            {
+                if( !use_delta )
+                {
+                    stale_ids.erase( entry.update->getTargetId() );
+                }
+                if( entry.update->isRemoval() )
+                {
+                    synced_versions.erase( entry.update->getTargetId() );
+                }
+                else
+                {
+                    synced_versions[ entry.update->getTargetId() ] = entry.update->getVersion();
+                }
+            }
+
+            auto entry_buffers = entry.update->getBuffers( use_delta );
+            auto const frames_end = is_frame_only ? std::end( entry_buffers ) : std::prev( std::end( entry_buffers ) );
+            if( !is_frame_only )
+            {
+                messages.emplace_back( entry_buffers.back() );
+            }
+            std::transform( std::begin( entry_buffers ),
+                            frames_end,
+                            std::back_inserter( buffers ),
+                            []( auto const& _frame ){ return message_type{ _frame }; } );
+
+            std::move( std::begin( entry.fences ), std::end( entry.fences ), std::back_inserter( writing_fences ) );
+            ++batch_updates;
+            batch_bytes += entry.bytes;
+            queued_bytes -= entry.bytes;
+            if( !is_frame_only )
+            {
+                queued_entries.erase( entry.update->getTargetId() );
+            }
+            queue.pop_front();
+        }
+    }
+
+    // The batch goes out as an array header followed by the cached messages, without copying them into one buffer.
+    if( 1 < messages.size() )
+    {
+        messages.insert( std::begin( messages ), std::make_shared< serialized_type const >( encodeArrayHeader( messages.size() ) ) );
+    }
+    if( !messages.empty() )
+    {
+        buffers.emplace_back( std::move( messages ) );
+    }
+
+    is_writing = true;
+    return buffers;
+}
+
+void SyncSession::complete()
+{
+    fence_array_type written_fences;
+    std::lock_guard< std::mutex > lock( mutex );
+    is_writing = false;
+    written_fences.swap( writing_fences );
+}
+
+std::vector< element_id_type > SyncSession::takeStaleIds()
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    if( is_writing || !isEmpty() )
+    {
+        return std::vector< element_id_type >{};
+    }
+
+    std::vector< element_id_type > result( std::begin( stale_ids ), std::end( stale_ids ) );
+    stale_ids.clear();
+    return result;
+}
+
+bool SyncSession::isDeltaApplicable( update_ptr_type const& _update ) const
+{
+    auto const version_it = synced_versions.find( _update->getTargetId() );
+    return _update->hasDelta()
+        && ( version_it != std::end( synced_versions ) )
+        && ( version_it->second == ( _update->getVersion() - 1 ) );
+}
+
+void SyncSession::dropOverBudget()
+{
+    auto const queued_frames = [this](){
+        return std::accumulate( std::begin( queues ),
+                                std::end( queues ),
+                                size_t( 0 ),
+                                []( size_t const _sum, auto const& _queue ){ return _sum + _queue.size(); } );
+    };
+
+    for( auto queue_it = queues.rbegin(); queue_it != queues.rend(); ++queue_it )
+    {
+        auto& queue = *queue_it;
+        while( !queue.empty() && ( 1 < queued_frames() ) && ( ( max_queued_frames < queued_frames() ) || ( max_queued_bytes < queued_bytes ) ) )
+        {
+            // A dropped frame only update is asked for again by the client when it still needs it.
+            auto const& entry = queue.front();
+            if( !entry.update->isFrameOnly() )
+            {
+                stale_ids.insert( entry.update->getTargetId() );
+                queued_entries.erase( entry.update->getTargetId() );
+            }
+            queued_bytes -= entry.bytes;
+            queue.pop_front();
+        }
+    }
+}
+
+bool SyncSession::isEmpty() const
+{
+    return std::all_of( std::begin( queues ), std::end( queues ), []( auto const& _queue ){ return _queue.empty(); } );
+}
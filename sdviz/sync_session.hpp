@@ -0,0 +1,79 @@
+#ifndef __SDVIZ_SYNC_SESSION_HPP__
+# define __SDVIZ_SYNC_SESSION_HPP__
+
+# include <array>
+# include <list>
+# include <memory>
+# include <mutex>
+# include <string>
+# include <unordered_map>
+# include <unordered_set>
+# include <vector>
+
+# include "fence.hpp"
+# include "serdes.hpp"
+
+namespace sdviz
+{
+    // Outbound state of one client connection. At most one update per element is queued:
+    // a newer update takes the place of an unsent older one. When the queue exceeds its
+    // frame or byte budget the oldest updates are dropped and their elements are marked
+    // stale, to be resynced once the queue has drained. Queued updates go out in batches,
+    // their frames first and then one array message holding all of them. Control updates are
+    // sent ahead of queued bulk ones and bulk ones are dropped first when over budget.
+    // A fence is held by every update queued or being written when it arrives and passes on
+    // to the update replacing one of them; dropped updates let go of it.
+    class SyncSession final
+    {
+        public:
+            using update_ptr_type = serialized_update_ptr_type;
+            // Parts written back to back as one WebSocket message.
+            using message_type = SerializedUpdate::buffer_array_type;
+            using message_array_type = std::vector< message_type >;
+
+            SyncSession( size_t const _max_queued_frames,
+                         size_t const _max_queued_bytes,
+                         size_t const _max_batch_updates,
+                         size_t const _max_batch_bytes );
+            SyncSession( SyncSession const& ) = delete;
+            SyncSession( SyncSession&& ) = delete;
+            ~SyncSession() = default;
+
+            SyncSession& operator =( SyncSession const& ) = delete;
+            SyncSession& operator =( SyncSession&& ) = delete;
+
+            void push( update_ptr_type const& _update );
+            void pushFence( fence_ptr_type const& _fence );
+            message_array_type next();
+            void complete();
+            std::vector< element_id_type > takeStaleIds();
+
+        private:
+            struct Entry
+            {
+                update_ptr_type update;
+                size_t bytes;
+                fence_array_type fences;
+            };
+
+            bool isDeltaApplicable( update_ptr_type const& _update ) const;
+            void dropOverBudget();
+
+            size_t const max_queued_frames;
+            size_t const max_queued_bytes;
+            size_t const max_batch_updates;
+            size_t const max_batch_bytes;
+            bool isEmpty() const;
+
+            std::array< std::list< Entry >, LaneCount > queues;
+            std::unordered_map< element_id_type, std::list< Entry >::iterator > queued_entries;
+            std::unordered_map< element_id_type, int > synced_versions;
+            std::unordered_set< element_id_type > stale_ids;
+            size_t queued_bytes;
+            bool is_writing;
+            fence_array_type writing_fences;
+            std::mutex mutex;
+    };
+}
+
+#endif // __SDVIZ_SYNC_SESSION_HPP__
@@ -0,0 +1,74 @@
+#include <algorithm>
+
+#include "tile_cache.hpp"
+
+using namespace sdviz;
+
+TileCache& TileCache::getInstance()
+{
+    static TileCache cache;
+    return cache;
+}
+
+TileCache::TileCache()
+    : size( 0 ),
+      capacity( 0 )
+{
+}
+
+void TileCache::start( Config const& _config )
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    capacity = std::max( 0, _config.max_tile_cache_bytes );
+    evict();
+}
+
+void TileCache::stop()
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    entries.clear();
+    index.clear();
+    size = 0;
+}
+
+TileCache::tile_ptr_type TileCache::get( key_type const& _key )
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    auto const index_it = index.find( _key );
+    if( index_it == std::end( index ) )
+    {
+        return nullptr;
+    }
+
+    entries.splice( std::begin( entries ), entries, index_it->second );
+    return std::get<1>( *index_it->second );
+}
+
+// Two encoders racing on the same tile both put it; the later one wins.
+void TileCache::put( key_type const& _key, tile_ptr_type const& _tile )
+{
+    std::lock_guard< std::mutex > lock( mutex );
+    auto const index_it = index.find( _key );
+    if( index_it != std::end( index ) )
+    {
+        size -= std::get<1>( *index_it->second )->size();
+        entries.erase( index_it->second );
+        index.erase( index_it );
+    }
+
+    entries.emplace_front( _key, _tile );
+    index.emplace( _key, std::begin( entries ) );
+    size += _tile->size();
+    evict();
+}
+
+void TileCache::evict()
+{
+    while( capacity < size )
+    {
+        auto const& entry = entries.back();
+        size -= std::get<1>( entry )->size();
+        index.erase( std::get<0>( entry ) );
+        entries.pop_back();
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef __SDVIZ_TILE_CACHE_HPP__
+# define __SDVIZ_TILE_CACHE_HPP__
+
+# include <list>
+# include <map>
+# include <memory>
+# include <mutex>
+# include <string>
+# include <tuple>
+
+# include "sdviz.hpp"
+
+namespace sdviz
+{
+    // Compressed tiles of tiled images, shared by all sessions and bounded in bytes. The least
+    // recently used tile is evicted first. Tiles are keyed by the element version, so those of
+    // replaced images are never hit again and age out.
+    class TileCache final
+    {
+        public:
+            // Element id, element version, canvas command index, level, tile column and tile row.
+            using key_type = std::tuple< element_id_type, int, int, int, int, int >;
+            using tile_ptr_type = std::shared_ptr< std::string const >;
+
+            TileCache( TileCache const& ) = delete;
+            TileCache( TileCache&& ) = delete;
+            ~TileCache() = default;
+
+            TileCache& operator =( TileCache const& ) = delete;
+            TileCache& operator =( TileCache&& ) = delete;
+
+            static TileCache& getInstance();
+            void start( Config const& _config );
+            void stop();
+            tile_ptr_type get( key_type const& _key );
+            void put( key_type const& _key, tile_ptr_type const& _tile );
+
+        private:
+            using entry_type = std::tuple< key_type, tile_ptr_type >;
+            using entry_list_type = std::list< entry_type >;
+
+            TileCache();
+            void evict();
+
+            // Most recently used first.
+            entry_list_type entries;
+            std::map< key_type, entry_list_type::iterator > index;
+            size_t size;
+            size_t capacity;
+            std::mutex mutex;
+    };
+}
+
+#endif // __SDVIZ_TILE_CACHE_HPP__
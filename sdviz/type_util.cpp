@@ -13,6 +13,16 @@ Image::Format sdviz::convertToImageFormat( ImageImpl::Format const _format )
             return Image::Format::UINT_8;
         case ImageImpl::Format::UINT_16:
             return Image::Format::UINT_16;
+        case ImageImpl::Format::BGR_888:
+            return Image::Format::BGR_888;
+        case ImageImpl::Format::BGRA_8888:
+            return Image::Format::BGRA_8888;
+        case ImageImpl::Format::RGBA_8888:
+            return Image::Format::RGBA_8888;
+        case ImageImpl::Format::INT_16:
+            return Image::Format::INT_16;
+        case ImageImpl::Format::FLOAT_32:
+            return Image::Format::FLOAT_32;
     }
 
     throw std::runtime_error( "Invalid image format." );
@@ -27,6 +37,16 @@ ImageImpl::Format sdviz::convertToImageImplFormat( Image::Format const _format )
             return ImageImpl::Format::UINT_8;
         case Image::Format::UINT_16:
             return ImageImpl::Format::UINT_16;
+        case Image::Format::BGR_888:
+            return ImageImpl::Format::BGR_888;
+        case Image::Format::BGRA_8888:
+            return ImageImpl::Format::BGRA_8888;
+        case Image::Format::RGBA_8888:
+            return ImageImpl::Format::RGBA_8888;
+        case Image::Format::INT_16:
+            return ImageImpl::Format::INT_16;
+        case Image::Format::FLOAT_32:
+            return ImageImpl::Format::FLOAT_32;
     }
 
     throw std::runtime_error( "Invalid image format." );
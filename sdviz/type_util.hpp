@@ -40,6 +40,25 @@ namespace sdviz
         static constexpr bool value = type::value;
     };
 
+    template< typename ParamType >
+    struct HasMaxPublishRate
+    {
+        template< typename T >
+        static std::true_type test( decltype( T::max_publish_rate )* )
+        {
+            return std::true_type();
+        }
+
+        template< typename T >
+        static std::false_type test( ... )
+        {
+            return std::false_type();
+        }
+
+        using type = decltype(test< ParamType >(0));
+        static constexpr bool value = type::value;
+    };
+
     template< typename WrapType >
     inline typename ImplTypeTraits< WrapType >::type::value_type convertToImplValue( typename WrapType::value_type const& _value )
     {
@@ -54,6 +73,26 @@ namespace sdviz
         return impl_value_type{ CanvasImpl{ *_canvas.getImpl() } };
     }
 
+    template< typename WrapType >
+    inline typename ImplTypeTraits< WrapType >::type::value_type convertToImplValue( typename WrapType::value_type&& _value )
+    {
+        using impl_value_type = typename ImplTypeTraits< WrapType >::type::value_type;
+        return impl_value_type{ std::move( _value ) };
+    }
+
+    // Commands shared with another copy of the canvas are copied, the others are taken over.
+    template<>
+    inline typename ImplTypeTraits< CanvasElement >::type::value_type convertToImplValue< CanvasElement >( CanvasElement::value_type&& _canvas )
+    {
+        using impl_value_type = typename ImplTypeTraits< CanvasElement >::type::value_type;
+        if( _canvas.isShared() )
+        {
+            return impl_value_type{ CanvasImpl{ *_canvas.getImpl() } };
+        }
+
+        return impl_value_type{ CanvasImpl{ std::move( *_canvas.getImpl() ) } };
+    }
+
     template< typename WrapType,
               typename std::enable_if_t<
                   !HasOnValueChanged< typename ImplTypeTraits< WrapType >::type::param_type >::value,
@@ -75,7 +114,8 @@ namespace sdviz
         using impl_param_type = typename ImplTypeTraits< WrapType >::type::param_type;
         return impl_param_type{
             _param.label,
-            _param.on_value_changed
+            _param.on_value_changed,
+            _param.coalesce_inbound
         };
     }
 
@@ -85,7 +125,17 @@ namespace sdviz
         using impl_param_type = typename ImplTypeTraits< ChartElement >::type::param_type;
         return impl_param_type{
             convertToChartImplType( _param.type ),
-            _param.value_map
+            _param.value_map,
+            _param.max_hz
+        };
+    }
+
+    template<>
+    inline typename ImplTypeTraits< CanvasElement >::type::param_type convertToImplParam< CanvasElement >( typename CanvasElement::param_type const& _param)
+    {
+        using impl_param_type = typename ImplTypeTraits< CanvasElement >::type::param_type;
+        return impl_param_type{
+            _param.max_fps
         };
     }
 
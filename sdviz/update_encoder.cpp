@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <iterator>
+
+#include "log.hpp"
+#include "model_sync_server.hpp"
+#include "update_encoder.hpp"
+
+using namespace sdviz;
+
+UpdateEncoder& UpdateEncoder::getInstance()
+{
+    static UpdateEncoder encoder;
+    return encoder;
+}
+
+UpdateEncoder::~UpdateEncoder()
+{
+    stop();
+}
+
+void UpdateEncoder::start( Config const& _config )
+{
+    stop();
+
+    std::lock_guard< std::mutex > lock( mutex );
+    is_running = true;
+    int const encoder_threads = std::max( 0, _config.encoder_threads );
+    for( int i = 0; i < encoder_threads; ++i )
+    {
+        workers.emplace_back( [this](){ loop(); } );
+    }
+}
+
+void UpdateEncoder::stop()
+{
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        is_running = false;
+    }
+    cond.notify_all();
+
+    for( auto& worker : workers )
+    {
+        worker.join();
+    }
+    workers.clear();
+
+    std::lock_guard< std::mutex > lock( mutex );
+    jobs.clear();
+    results.clear();
+}
+
+void UpdateEncoder::submit( receiver_type const& _receiver, update_job_array_type&& _jobs, fence_array_type&& _fences )
+{
+    std::vector< std::tuple< uint64_t, update_job_type > > inline_jobs;
+    bool const is_fence_only = _jobs.empty() && !_fences.empty();
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        for( auto& job : _jobs )
+        {
+            uint64_t const sequence = next_sequence++;
+            results.emplace( sequence, Result{ _receiver, nullptr, fence_array_type{}, false } );
+            if( workers.empty() )
+            {
+                inline_jobs.emplace_back( sequence, std::move( job ) );
+            }
+            else
+            {
+                jobs.emplace_back( sequence, std::move( job ) );
+            }
+        }
+
+        if( is_fence_only )
+        {
+            results.emplace( next_sequence++, Result{ _receiver, nullptr, std::move( _fences ), true } );
+        }
+        else if( !_fences.empty() )
+        {
+            results.rbegin()->second.fences = std::move( _fences );
+        }
+    }
+    cond.notify_all();
+
+    for( auto const& sequence_job : inline_jobs )
+    {
+        encode( std::get<0>( sequence_job ), std::get<1>( sequence_job ) );
+    }
+
+    if( is_fence_only )
+    {
+        flush();
+    }
+}
+
+UpdateEncoder::UpdateEncoder()
+    : next_sequence( 0 ),
+      is_running( false )
+{
+}
+
+void UpdateEncoder::loop()
+{
+    while( true )
+    {
+        std::tuple< uint64_t, update_job_type > sequence_job;
+        {
+            std::unique_lock< std::mutex > lock( mutex );
+            cond.wait( lock, [this](){ return !is_running || !jobs.empty(); } );
+            if( !is_running )
+            {
+                return;
+            }
+
+            sequence_job = std::move( jobs.front() );
+            jobs.pop_front();
+        }
+
+        encode( std::get<0>( sequence_job ), std::get<1>( sequence_job ) );
+    }
+}
+
+void UpdateEncoder::encode( uint64_t const _sequence, update_job_type const& _job )
+{
+    SyncSession::update_ptr_type update;
+    try
+    {
+        update = _job();
+        // Serialize the form most sessions will send while still off the flushing path.
+        update->getBuffers( update->hasDelta() );
+    }
+    catch( std::exception& e )
+    {
+        LOG(error) << e.what();
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( mutex );
+        auto const result_it = results.find( _sequence );
+        if( result_it == std::end( results ) )
+        {
+            return;
+        }
+
+        result_it->second.update = update;
+        result_it->second.is_done = true;
+    }
+
+    flush();
+}
+
+// Sends the finished prefix of the results. Flushes are serialized, so results leave in order.
+void UpdateEncoder::flush()
+{
+    std::lock_guard< std::mutex > flush_lock( flush_mutex );
+    while( true )
+    {
+        std::vector< Result > ready;
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            auto result_it = std::begin( results );
+            for( ; ( result_it != std::end( results ) ) && result_it->second.is_done; ++result_it )
+            {
+                ready.emplace_back( std::move( result_it->second ) );
+            }
+            results.erase( std::begin( results ), result_it );
+        }
+
+        if( ready.empty() )
+        {
+            return;
+        }
+
+        auto ready_it = std::begin( ready );
+        while( ready_it != std::end( ready ) )
+        {
+            auto const receiver = ready_it->receiver;
+            std::vector< SyncSession::update_ptr_type > updates;
+            fence_array_type fences;
+            for( ; ( ready_it != std::end( ready ) ) && ( ready_it->receiver == receiver ); ++ready_it )
+            {
+                if( ready_it->update )
+                {
+                    updates.emplace_back( ready_it->update );
+                }
+                std::move( std::begin( ready_it->fences ), std::end( ready_it->fences ), std::back_inserter( fences ) );
+            }
+
+            if( updates.empty() && fences.empty() )
+            {
+                continue;
+            }
+
+            if( receiver )
+            {
+                ModelSyncServer::getInstance().sendAction( updates, fences, *receiver );
+            }
+            else
+            {
+                ModelSyncServer::getInstance().sendAction( updates, fences );
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef __SDVIZ_UPDATE_ENCODER_HPP__
+# define __SDVIZ_UPDATE_ENCODER_HPP__
+
+# include <cstdint>
+# include <condition_variable>
+# include <deque>
+# include <map>
+# include <mutex>
+# include <string>
+# include <thread>
+# include <tuple>
+# include <vector>
+
+# include <boost/optional.hpp>
+
+# include "fence.hpp"
+# include "sdviz.hpp"
+# include "serdes.hpp"
+# include "sync_session.hpp"
+
+namespace sdviz
+{
+    // Encodes element snapshots into serialized updates on a pool of worker threads and hands
+    // them to the server in submission order, whichever worker finishes first. Without worker
+    // threads jobs are encoded on the submitting thread. Fences are passed on to the server
+    // right after the updates submitted along with them.
+    class UpdateEncoder final
+    {
+        public:
+            using receiver_type = boost::optional< std::string >;
+
+            UpdateEncoder( UpdateEncoder const& ) = delete;
+            UpdateEncoder( UpdateEncoder&& ) = delete;
+            ~UpdateEncoder();
+
+            UpdateEncoder& operator =( UpdateEncoder const& ) = delete;
+            UpdateEncoder& operator =( UpdateEncoder&& ) = delete;
+
+            static UpdateEncoder& getInstance();
+            void start( Config const& _config );
+            void stop();
+            void submit( receiver_type const& _receiver, update_job_array_type&& _jobs, fence_array_type&& _fences );
+
+        private:
+            struct Result
+            {
+                receiver_type receiver;
+                SyncSession::update_ptr_type update;
+                fence_array_type fences;
+                bool is_done;
+            };
+
+            UpdateEncoder();
+            void loop();
+            void encode( uint64_t const _sequence, update_job_type const& _job );
+            void flush();
+
+            std::vector< std::thread > workers;
+            std::deque< std::tuple< uint64_t, update_job_type > > jobs;
+            std::map< uint64_t, Result > results;
+            uint64_t next_sequence;
+            bool is_running;
+            std::mutex mutex;
+            std::mutex flush_mutex;
+            std::condition_variable cond;
+    };
+}
+
+#endif // __SDVIZ_UPDATE_ENCODER_HPP__
@@ -1,12 +1,15 @@
 #ifndef __SDVIZ_ACTION_DISPATCH_HPP__
 # define __SDVIZ_ACTION_DISPATCH_HPP__
 
+# include <algorithm>
 # include <string>
 # include <sstream>
 
 # include <boost/variant.hpp>
+# include <boost/optional.hpp>
 
 # include "./action.hpp"
+# include "./callback_executor.hpp"
 # include "./resource.hpp"
 # include "./serdes.hpp"
 # include "./log.hpp"
@@ -14,7 +17,7 @@
 
 namespace sdviz
 {
-    struct ElementImplActionVisitor : public boost::static_visitor< intermediate_type >
+    struct ElementImplActionVisitor : public boost::static_visitor< update_job_type >
     {
         template< typename ParamType,
                   typename ValueType,
@@ -22,9 +25,13 @@ namespace sdviz
                       HasOnValueChanged< ParamType >::value,
                       std::nullptr_t
                   > = nullptr >
-        static void runOnValueChanged( ParamType const& _param, ValueType const& _current, ValueType const& _next )
+        static void runOnValueChanged( element_id_type const _target_id, ParamType const& _param, ValueType const& _current, ValueType const& _next )
         {
-            _param.on_value_changed( _current, _next );
+            CallbackExecutor::getInstance().postChange( _target_id,
+                                                        std::function< void( ValueType, ValueType ) >{ _param.on_value_changed },
+                                                        _current,
+                                                        _next,
+                                                        _param.coalesce_inbound );
         }
 
         template< typename ParamType,
@@ -33,20 +40,22 @@ namespace sdviz
                       !HasOnValueChanged< ParamType >::value,
                       std::nullptr_t
                   > = nullptr >
-        static void runOnValueChanged( ParamType const&, ValueType const&, ValueType const& )
+        static void runOnValueChanged( element_id_type const, ParamType const&, ValueType const&, ValueType const& )
         {
         }
 
-        intermediate_type operator()( ContainerElementImpl& _element_impl, AddElementImplAction& _action ) const
+        update_job_type operator()( ContainerElementImpl& _element_impl, AddElementImplAction& _action ) const
         {
             int const span = std::get<0>( _action.payload );
-            std::string const& id = std::get<1>( _action.payload );
+            element_id_type const id = std::get<1>( _action.payload );
 
+            auto const previous_value = _element_impl.getValuePtr();
             auto new_value{ _element_impl.getValue() };
             new_value.emplace_back( std::make_tuple( span, id ) );
             _element_impl.setValue( std::move( new_value ) );
+            element_store.addParent( id, _action.target_id );
 
-            return elementImplToIntermediateType( _action.target_id, _element_impl );
+            return makeUpdateJob( _action.target_id, _element_impl, previous_value );
         }
 
         template< typename ElementImplType,
@@ -58,12 +67,13 @@ namespace sdviz
                       >::value,
                       std::nullptr_t
                   > = nullptr >
-        intermediate_type operator()( ElementImplType& _element_impl, ActionType& _action ) const
+        update_job_type operator()( ElementImplType& _element_impl, ActionType& _action ) const
         {
-            runOnValueChanged( _element_impl.getParam(), _element_impl.getValue(), _action.payload );
+            runOnValueChanged( _action.target_id, _element_impl.getParam(), _element_impl.getValue(), _action.payload );
 
+            auto const previous_value = _element_impl.getValuePtr();
             _element_impl.setValue( std::move( _action.payload ) );
-            return elementImplToIntermediateType( _action.target_id, _element_impl );
+            return makeUpdateJob( _action.target_id, _element_impl, previous_value );
         }
 
         template< typename ElementImplType,
@@ -75,10 +85,10 @@ namespace sdviz
                       >::value,
                       std::nullptr_t
                   > = nullptr >
-        intermediate_type operator()( ElementImplType& _element_impl, ActionType& _action ) const
+        update_job_type operator()( ElementImplType& _element_impl, ActionType& _action ) const
         {
             _element_impl.setParam( std::move( _action.payload ) );
-            return elementImplToIntermediateType( _action.target_id, _element_impl );
+            return makeUpdateJob( _action.target_id, _element_impl );
         }
 
         template< typename ElementImplType,
@@ -94,41 +104,243 @@ namespace sdviz
                       >::value,
                       std::nullptr_t
                   > = nullptr >
-        intermediate_type operator()( ElementImplType&, ActionType& ) const
+        update_job_type operator()( ElementImplType&, ActionType& ) const
         {
             throw std::runtime_error( "Invalid ElementImplAction dispatch." );
         }
     };
 
-    struct ActionVisitor : public boost::static_visitor< intermediate_type >
+    // Yields the connection an action has to be synced to, or none when it is broadcast.
+    struct SyncReceiverVisitor : public boost::static_visitor< boost::optional< std::string > >
     {
-        intermediate_type operator()( CreateElementImplAction& _action ) const
+        boost::optional< std::string > operator()( SyncAction const& _action ) const
         {
-            element_store.insert( std::make_pair( _action.target_id, std::move( _action.payload ) ) );
+            return _action.payload.connection_id;
+        }
+
+        boost::optional< std::string > operator()( FrameRequestAction const& _action ) const
+        {
+            return _action.payload.connection_id;
+        }
 
-            std::map< std::string, intermediate_type > result;
-            return elementImplToIntermediateType( _action.target_id, element_store.at( _action.target_id ) );
+        template< typename ActionType >
+        boost::optional< std::string > operator()( ActionType const& ) const
+        {
+            return boost::none;
+        }
+    };
+
+    // Yields how many value updates per second an element may publish, 0 for unlimited.
+    struct MaxPublishRateVisitor : public boost::static_visitor< double >
+    {
+        template< typename ElementImplType,
+                  typename std::enable_if_t<
+                      HasMaxPublishRate< typename ElementImplType::param_type >::value,
+                      std::nullptr_t
+                  > = nullptr >
+        double operator()( ElementImplType const& _element_impl ) const
+        {
+            return std::max( 0.0, _element_impl.getParam().max_publish_rate );
         }
 
-        intermediate_type operator()( SyncAction& ) const
+        template< typename ElementImplType,
+                  typename std::enable_if_t<
+                      !HasMaxPublishRate< typename ElementImplType::param_type >::value,
+                      std::nullptr_t
+                  > = nullptr >
+        double operator()( ElementImplType const& ) const
         {
-            intermediate_array_type result;
-            for( auto const& id_element : element_store )
+            return 0.0;
+        }
+    };
+
+    // Tells whether set-values of an element may be merged before they are applied. Each one of
+    // an element with an on_value_changed callback is a change the callback expects to see,
+    // unless the element asked for its inbound changes to be coalesced.
+    struct IsCoalescibleVisitor : public boost::static_visitor< bool >
+    {
+        template< typename ElementImplType,
+                  typename std::enable_if_t<
+                      HasOnValueChanged< typename ElementImplType::param_type >::value,
+                      std::nullptr_t
+                  > = nullptr >
+        bool operator()( ElementImplType const& _element_impl ) const
+        {
+            return _element_impl.getParam().coalesce_inbound;
+        }
+
+        template< typename ElementImplType,
+                  typename std::enable_if_t<
+                      !HasOnValueChanged< typename ElementImplType::param_type >::value,
+                      std::nullptr_t
+                  > = nullptr >
+        bool operator()( ElementImplType const& ) const
+        {
+            return true;
+        }
+    };
+
+    struct ActionLaneVisitor : public boost::static_visitor< size_t >
+    {
+        size_t operator()( OverflowAction const& _action ) const
+        {
+            return _action.payload.lane;
+        }
+
+        size_t operator()( DeleteElementImplAction const& _action ) const
+        {
+            return _action.payload.lane;
+        }
+
+        template< typename ActionType >
+        size_t operator()( ActionType const& ) const
+        {
+            return ActionLane< ActionType >::value;
+        }
+    };
+
+    struct IsSetValueActionVisitor : public boost::static_visitor< bool >
+    {
+        template< typename ActionType >
+        bool operator()( ActionType const& ) const
+        {
+            return IsSetValueAction< ActionType >::value;
+        }
+    };
+
+    struct ActionVisitor : public boost::static_visitor< update_job_array_type >
+    {
+        update_job_array_type operator()( CreateElementImplAction& _action ) const
+        {
+            element_store.insert( _action.target_id, std::move( _action.payload ) );
+
+            auto const& element_impl_variant = element_store.at( _action.target_id );
+            return update_job_array_type{ makeFullUpdateJob( _action.target_id, element_impl_variant ) };
+        }
+
+        update_job_array_type operator()( OverflowAction& ) const
+        {
+            return update_job_array_type{};
+        }
+
+        update_job_array_type operator()( FenceAction& ) const
+        {
+            return update_job_array_type{};
+        }
+
+        // Frees the element and its id, detaches it from the containers holding it and tells
+        // the clients to drop it.
+        update_job_array_type operator()( DeleteElementImplAction& _action ) const
+        {
+            if( !element_store.find( _action.target_id ) )
+            {
+                return update_job_array_type{};
+            }
+
+            auto parent_ids = element_store.erase( _action.target_id );
+            releaseElementId( _action.target_id );
+            std::sort( std::begin( parent_ids ), std::end( parent_ids ) );
+            parent_ids.erase( std::unique( std::begin( parent_ids ), std::end( parent_ids ) ), std::end( parent_ids ) );
+
+            update_job_array_type result;
+            for( auto const parent_id : parent_ids )
+            {
+                auto const parent = element_store.find( parent_id );
+                auto const container = parent ? boost::get< ContainerElementImpl >( parent ) : nullptr;
+                if( !container )
+                {
+                    continue;
+                }
+
+                auto const previous_value = container->getValuePtr();
+                auto new_value{ container->getValue() };
+                new_value.erase( std::remove_if( std::begin( new_value ),
+                                                 std::end( new_value ),
+                                                 [&_action]( auto const& _entry ){ return std::get<1>( _entry ) == _action.target_id; } ),
+                                 std::end( new_value ) );
+                container->setValue( std::move( new_value ) );
+                result.emplace_back( makeUpdateJob( parent_id, *container, previous_value ) );
+            }
+
+            result.emplace_back( makeRemovalUpdateJob( _action.target_id ) );
+            return result;
+        }
+
+        // Requests for an outdated version or anything but a pyramid level of an image are ignored.
+        update_job_array_type operator()( FrameRequestAction& _action ) const
+        {
+            auto const element_impl_variant = element_store.find( _action.target_id );
+            auto const canvas = element_impl_variant ? boost::get< CanvasElementImpl >( element_impl_variant ) : nullptr;
+            if( !canvas || ( canvas->getVersion() != _action.payload.version ) )
+            {
+                return update_job_array_type{};
+            }
+
+            auto const& request = _action.payload;
+            auto const& value = canvas->getValue();
+            if( ( request.command_index < 0 ) || ( static_cast< int >( value.size() ) <= request.command_index ) )
+            {
+                return update_job_array_type{};
+            }
+
+            auto const image_command = boost::get< CanvasImpl::ImageCommand >( &( *std::next( value.cbegin(), request.command_index ) ) );
+            if( !image_command )
+            {
+                return update_job_array_type{};
+            }
+
+            auto const& image = std::get<0>( image_command->getParam() );
+            if( ( request.level < 0 ) || ( image.getLevelCount() <= request.level ) )
+            {
+                return update_job_array_type{};
+            }
+
+            if( request.is_tile
+                && ( !image.isTiled()
+                     || ( request.tile_column < 0 )
+                     || ( request.tile_row < 0 )
+                     || ( ImagePyramid::GetTileCount( image.getWidth(), request.level ) <= request.tile_column )
+                     || ( ImagePyramid::GetTileCount( image.getHeight(), request.level ) <= request.tile_row ) ) )
+            {
+                return update_job_array_type{};
+            }
+
+            return update_job_array_type{ makeFrameUpdateJob( _action.target_id, *canvas, request ) };
+        }
+
+        update_job_array_type operator()( SyncAction& _action ) const
+        {
+            update_job_array_type result;
+            if( _action.payload.target_ids.empty() )
+            {
+                element_store.forEach( [&result]( element_id_type const _id, ElementImplVariant const& _element_impl_variant ){
+                    result.emplace_back( makeFullUpdateJob( _id, _element_impl_variant ) );
+                });
+            }
+
+            for( auto const& target_id : _action.payload.target_ids )
             {
-                auto const& target_id = std::get<0>( id_element );
-                auto const& element_impl_variant = std::get<1>( id_element );
-                result.emplace_back( elementImplToIntermediateType( target_id, element_impl_variant ) );
+                // An element deleted in the meantime may still be shown by the client.
+                auto const element_impl_variant = element_store.find( target_id );
+                if( element_impl_variant )
+                {
+                    result.emplace_back( makeFullUpdateJob( target_id, *element_impl_variant ) );
+                }
+                else
+                {
+                    result.emplace_back( makeRemovalUpdateJob( target_id ) );
+                }
             }
 
             return result;
         }
 
         template< typename ActionType >
-        intermediate_type operator()( ActionType& _action ) const
+        update_job_array_type operator()( ActionType& _action ) const
         {
             auto& element_impl_variant = element_store.at( _action.target_id );
             auto visitor = std::bind( ElementImplActionVisitor{}, std::placeholders::_1, std::ref( _action ) );
-            return boost::apply_visitor( visitor, element_impl_variant );
+            return update_job_array_type{ boost::apply_visitor( visitor, element_impl_variant ) };
         }
     };
 
@@ -0,0 +1,66 @@
+#include <memory>
+#include <vector>
+
+#include <boost/variant.hpp>
+
+#include "canvas_impl.hpp"
+#include "image_impl.hpp"
+#include "sdviz.hpp"
+#include "test_util.hpp"
+
+namespace
+{
+    int const width = 8;
+    int const height = 4;
+
+    uint8_t const* drawnBuffer( sdviz::Canvas const& _canvas )
+    {
+        auto const& command = *std::prev( _canvas.getImpl()->cend() );
+        auto const& image_command = boost::get< sdviz::CanvasImpl::ImageCommand >( command );
+        return std::get<0>( image_command.getParam() ).getBuffer();
+    }
+
+    // The caller may reuse a raw buffer right after drawing it, so the canvas needs its own copy
+    // even when the image is passed as an rvalue.
+    void testRawBufferIsCopied()
+    {
+        std::vector< uint8_t > frame( width * height * 3, 0x7f );
+        sdviz::Canvas canvas( width, height );
+        canvas.drawImage( sdviz::Image( width, height, sdviz::Image::RGB_888, frame.data() ), std::make_tuple( 0, 0 ) );
+
+        SDVIZ_CHECK( drawnBuffer( canvas ) != frame.data() );
+        frame.assign( frame.size(), 0x00 );
+        SDVIZ_CHECK( drawnBuffer( canvas )[ 0 ] == 0x7f );
+    }
+
+    void testFrozenRawBufferIsShared()
+    {
+        std::vector< uint8_t > frame( width * height * 3, 0x7f );
+        sdviz::Canvas canvas( width, height );
+        canvas.drawImage( sdviz::Image( width, height, sdviz::Image::RGB_888, frame.data() ).freeze(), std::make_tuple( 0, 0 ) );
+
+        SDVIZ_CHECK( drawnBuffer( canvas ) == frame.data() );
+    }
+
+    void testOwnedBufferIsShared()
+    {
+        std::shared_ptr< uint8_t > frame( new uint8_t[ width * height * 3 ], std::default_delete< uint8_t[] >() );
+        sdviz::Canvas canvas( width, height );
+        canvas.drawImage( sdviz::Image( width, height, sdviz::Image::RGB_888, frame ), std::make_tuple( 0, 0 ) );
+        SDVIZ_CHECK( drawnBuffer( canvas ) == frame.get() );
+
+        sdviz::Image allocated( width, height, sdviz::Image::RGB_888 );
+        uint8_t const* const allocated_buffer = allocated.getBuffer();
+        canvas.drawImage( std::move( allocated ), std::make_tuple( 0, 0 ) );
+        SDVIZ_CHECK( drawnBuffer( canvas ) == allocated_buffer );
+    }
+}
+
+int main()
+{
+    testRawBufferIsCopied();
+    testFrozenRawBufferIsShared();
+    testOwnedBufferIsShared();
+
+    return SDVIZ_TEST_RESULT();
+}
@@ -0,0 +1,53 @@
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "sdviz.hpp"
+#include "test_util.hpp"
+
+namespace
+{
+    // Both set-values land in one coalescing window, yet the button keeps coalesce_inbound off,
+    // so its callback has to see each of them.
+    void testButtonSetValuesAreNotCoalesced()
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::vector< std::tuple< bool, bool > > changes;
+
+        sdviz::ButtonElementParam param;
+        param.on_value_changed = [&]( bool _current, bool _next ){
+            std::lock_guard< std::mutex > lock( mutex );
+            changes.emplace_back( _current, _next );
+            cond.notify_all();
+        };
+        auto button = sdviz::ButtonElement::create( false, param );
+        sdviz::flush();
+
+        SDVIZ_CHECK( button.setValue( true ) );
+        SDVIZ_CHECK( button.setValue( false ) );
+
+        std::unique_lock< std::mutex > lock( mutex );
+        cond.wait_for( lock, std::chrono::seconds( 5 ), [&](){ return 2 <= changes.size(); } );
+        SDVIZ_CHECK( changes.size() == 2 );
+        if( changes.size() == 2 )
+        {
+            SDVIZ_CHECK( changes[0] == std::make_tuple( false, true ) );
+            SDVIZ_CHECK( changes[1] == std::make_tuple( true, false ) );
+        }
+    }
+}
+
+int main()
+{
+    sdviz::Config config;
+    config.coalescing_interval_ms = 200;
+    sdviz::start( config );
+
+    testButtonSetValuesAreNotCoalesced();
+
+    sdviz::stop();
+    return SDVIZ_TEST_RESULT();
+}
@@ -0,0 +1,27 @@
+#include <set>
+
+#include "resource.hpp"
+#include "test_util.hpp"
+
+using namespace sdviz;
+
+int main()
+{
+    // Reusing a slot over and over never hands out an id twice, the slot is retired once its
+    // generations are used up.
+    std::set< element_id_type > ids;
+    element_id_type const first_id = generateElmenetId();
+    ids.insert( first_id );
+    element_id_type id = first_id;
+    for( int i = 0; i < 300; ++i )
+    {
+        releaseElementId( id );
+        id = generateElmenetId();
+        SDVIZ_CHECK( ids.insert( id ).second );
+    }
+
+    SDVIZ_CHECK( ( id & element_index_mask ) != ( first_id & element_index_mask ) );
+    SDVIZ_CHECK( ids.size() == 301 );
+
+    return SDVIZ_TEST_RESULT();
+}
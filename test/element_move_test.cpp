@@ -0,0 +1,91 @@
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sdviz.hpp"
+#include "test_util.hpp"
+
+namespace
+{
+    // Allocations made by the calling thread, so the sync loop and other threads don't count.
+    thread_local size_t allocation_count = 0;
+
+    int const series_count = 64;
+
+    sdviz::ChartElement::value_type makeChartValue()
+    {
+        sdviz::ChartElement::value_type value;
+        for( int i = 0; i < series_count; ++i )
+        {
+            value.emplace( "series" + std::to_string( i ) + std::string( 32, '_' ), std::vector< double >( 1024, i ) );
+        }
+        return value;
+    }
+
+    // Copying the value would allocate each map node, key and series again. Moving it only
+    // allocates the queued action, so far fewer allocations than there are series.
+    template< typename PushFunc >
+    size_t countAllocations( PushFunc _push )
+    {
+        auto value = makeChartValue();
+        size_t const before = allocation_count;
+        _push( std::move( value ) );
+        return allocation_count - before;
+    }
+
+    void testChartValueIsMoved()
+    {
+        sdviz::ChartElementParam param;
+        param.type = sdviz::ChartElementParam::Line;
+
+        size_t const create_allocations = countAllocations( [&]( auto&& _value ){
+            sdviz::ChartElement::create( std::move( _value ), param );
+        });
+        SDVIZ_CHECK( create_allocations < series_count );
+
+        auto chart = sdviz::ChartElement::create( makeChartValue(), param );
+        size_t const move_allocations = countAllocations( [&]( auto&& _value ){
+            SDVIZ_CHECK( chart.setValue( std::move( _value ) ) );
+        });
+        SDVIZ_CHECK( move_allocations < series_count );
+
+        // The const overload copies, which shows the count would catch a copy.
+        size_t const copy_allocations = countAllocations( [&]( auto const& _value ){
+            SDVIZ_CHECK( chart.setValue( _value ) );
+        });
+        SDVIZ_CHECK( 2 * series_count <= copy_allocations );
+    }
+}
+
+void* operator new( size_t _size )
+{
+    ++allocation_count;
+    if( void* const ptr = std::malloc( _size ? _size : 1 ) )
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete( void* _ptr ) noexcept
+{
+    std::free( _ptr );
+}
+
+void operator delete( void* _ptr, size_t ) noexcept
+{
+    std::free( _ptr );
+}
+
+int main()
+{
+    sdviz::start();
+
+    testChartValueIsMoved();
+
+    sdviz::stop();
+    return SDVIZ_TEST_RESULT();
+}
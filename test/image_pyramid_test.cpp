@@ -0,0 +1,135 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "image_impl.hpp"
+#include "image_pyramid.hpp"
+#include "test_util.hpp"
+
+using namespace sdviz;
+
+namespace
+{
+    std::mt19937 random_engine( 4321 );
+
+    template< typename T >
+    T averagePair( T const _a, T const _b )
+    {
+        return static_cast< T >( ( _a + _b + 1 ) >> 1 );
+    }
+
+    float averagePair( float const _a, float const _b )
+    {
+        return ( _a + _b ) * 0.5f;
+    }
+
+    template< typename T >
+    T getValue( ImageImpl const& _image, int const _x, int const _y, int const _channel )
+    {
+        T value;
+        size_t const offset = _y * _image.getStride() + ( _x * ImageImpl::GetChannelsPerPixel( _image ) + _channel ) * sizeof( T );
+        std::memcpy( &value, _image.getBuffer() + offset, sizeof( T ) );
+        return value;
+    }
+
+    // The 2x2 box filter one pixel at a time: rows averaged first, then the column pair, each
+    // with the same rounding as the kernels.
+    template< typename T >
+    bool matchesReference( ImageImpl const& _src, ImageImpl const& _dst )
+    {
+        int const channels = ImageImpl::GetChannelsPerPixel( _src );
+        for( int y = 0; y < _dst.getHeight(); ++y )
+        {
+            int const y0 = 2 * y;
+            int const y1 = std::min( 2 * y + 1, _src.getHeight() - 1 );
+            for( int x = 0; x < _dst.getWidth(); ++x )
+            {
+                int const x0 = 2 * x;
+                int const x1 = std::min( 2 * x + 1, _src.getWidth() - 1 );
+                for( int channel = 0; channel < channels; ++channel )
+                {
+                    T const left = averagePair( getValue< T >( _src, x0, y0, channel ), getValue< T >( _src, x0, y1, channel ) );
+                    T const right = averagePair( getValue< T >( _src, x1, y0, channel ), getValue< T >( _src, x1, y1, channel ) );
+                    if( averagePair( left, right ) != getValue< T >( _dst, x, y, channel ) )
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    template< typename T >
+    ImageImpl makeRandomImage( int const _width, int const _height, ImageImpl::Format const _format )
+    {
+        ImageImpl image( _width, _height, _format );
+        size_t const values = _width * _height * ImageImpl::GetChannelsPerPixel( image );
+        std::uniform_int_distribution< int > dist( -32768, 32767 );
+        for( size_t i = 0; i < values; ++i )
+        {
+            T const value = static_cast< T >( dist( random_engine ) );
+            std::memcpy( image.getBuffer() + i * sizeof( T ), &value, sizeof( T ) );
+        }
+
+        return image;
+    }
+
+    // Odd sizes on either side, with levels which round down to odd sizes again.
+    template< typename T >
+    void testLevels( ImageImpl::Format const _format )
+    {
+        int const sizes[][2] = { { 601, 301 }, { 1025, 3 }, { 2, 1027 }, { 777, 777 }, { 300, 1 } };
+        for( auto const& size : sizes )
+        {
+            auto image = makeRandomImage< T >( size[0], size[1], _format );
+            image.enablePyramid();
+
+            int const level_count = image.getLevelCount();
+            SDVIZ_CHECK( level_count == ImagePyramid::GetLevelCount( size[0], size[1] ) );
+            SDVIZ_CHECK( std::max( ImagePyramid::GetLevelExtent( size[0], level_count - 1 ),
+                                   ImagePyramid::GetLevelExtent( size[1], level_count - 1 ) ) <= ImagePyramid::min_level_size
+                         || ( ImagePyramid::GetLevelExtent( size[0], level_count - 1 ) == 1 )
+                         || ( ImagePyramid::GetLevelExtent( size[1], level_count - 1 ) == 1 ) );
+
+            ImageImpl previous = image.getLevel( 0 );
+            for( int level = 1; level < level_count; ++level )
+            {
+                auto const current = image.getLevel( level );
+                SDVIZ_CHECK( current.getWidth() == ImagePyramid::GetLevelExtent( size[0], level ) );
+                SDVIZ_CHECK( current.getHeight() == ImagePyramid::GetLevelExtent( size[1], level ) );
+                SDVIZ_CHECK( current.getWidth() == std::max( previous.getWidth() / 2, 1 ) );
+                SDVIZ_CHECK( current.getHeight() == std::max( previous.getHeight() / 2, 1 ) );
+                SDVIZ_CHECK( ImagePyramid::GetTileCount( size[0], level ) == ( current.getWidth() + ImagePyramid::tile_size - 1 ) / ImagePyramid::tile_size );
+                SDVIZ_CHECK( matchesReference< T >( previous, current ) );
+                previous = current;
+            }
+        }
+    }
+
+    void testLevelCounts()
+    {
+        SDVIZ_CHECK( ImagePyramid::GetLevelCount( 256, 256 ) == 1 );
+        SDVIZ_CHECK( ImagePyramid::GetLevelCount( 257, 1 ) == 1 );
+        SDVIZ_CHECK( ImagePyramid::GetLevelCount( 257, 2 ) == 2 );
+        SDVIZ_CHECK( ImagePyramid::GetLevelCount( 1025, 1025 ) == 3 );
+        SDVIZ_CHECK( ImagePyramid::GetLevelCount( 513, 513 ) == 2 );
+        SDVIZ_CHECK( ImagePyramid::GetLevelExtent( 513, 2 ) == 128 );
+        SDVIZ_CHECK( ImagePyramid::GetLevelExtent( 3, 5 ) == 1 );
+        SDVIZ_CHECK( ImagePyramid::GetTileCount( 513, 0 ) == 3 );
+        SDVIZ_CHECK( ImagePyramid::GetTileCount( 513, 1 ) == 1 );
+    }
+}
+
+int main()
+{
+    testLevelCounts();
+    testLevels< uint8_t >( ImageImpl::Format::RGB_888 );
+    testLevels< uint8_t >( ImageImpl::Format::BGRA_8888 );
+    testLevels< uint16_t >( ImageImpl::Format::UINT_16 );
+    testLevels< int16_t >( ImageImpl::Format::INT_16 );
+    testLevels< float >( ImageImpl::Format::FLOAT_32 );
+    return SDVIZ_TEST_RESULT();
+}
@@ -0,0 +1,90 @@
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+
+namespace
+{
+    // The mutex guarded queue MPSCQueue replaced, as the baseline.
+    class LockedQueue final
+    {
+        public:
+            void push( int&& _item )
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                items.push_back( _item );
+                cond.notify_one();
+            }
+
+            int& front()
+            {
+                std::unique_lock< std::mutex > lock( mutex );
+                cond.wait( lock, [this](){ return !items.empty(); } );
+                return items.front();
+            }
+
+            void pop()
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                items.pop_front();
+            }
+
+        private:
+            std::deque< int > items;
+            std::mutex mutex;
+            std::condition_variable cond;
+    };
+
+    int const items_per_producer = 1000000;
+
+    template< typename QueueType >
+    double measure( int const _producers )
+    {
+        QueueType queue;
+        auto const begin = std::chrono::steady_clock::now();
+        std::vector< std::thread > producers;
+        for( int producer = 0; producer < _producers; ++producer )
+        {
+            producers.emplace_back( [&queue](){
+                for( int i = 0; i < items_per_producer; ++i )
+                {
+                    queue.push( int{ i } );
+                }
+            });
+        }
+
+        long long sum = 0;
+        for( int i = 0; i < _producers * items_per_producer; ++i )
+        {
+            sum += queue.front();
+            queue.pop();
+        }
+        auto const end = std::chrono::steady_clock::now();
+
+        for( auto& producer : producers )
+        {
+            producer.join();
+        }
+
+        double const seconds = std::chrono::duration< double >( end - begin ).count();
+        return ( sum < 0 ) ? 0.0 : _producers * items_per_producer / seconds;
+    }
+}
+
+// Prints items per second through one consumer, for MPSCQueue and the mutex guarded baseline.
+int main()
+{
+    for( int const producers : { 1, 4, 16 } )
+    {
+        std::cout << producers << " producers: "
+                  << "MPSCQueue " << measure< sdviz::MPSCQueue< int > >( producers ) / 1e6 << " M items/s, "
+                  << "locked deque " << measure< LockedQueue >( producers ) / 1e6 << " M items/s" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <atomic>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+#include "test_util.hpp"
+
+namespace
+{
+    // Producer index and sequence number within the producer.
+    using item_type = std::tuple< int, int >;
+
+    struct ParityLanePolicy
+    {
+        static constexpr size_t lanes = 2;
+
+        size_t operator()( item_type const& _item ) const
+        {
+            return static_cast< size_t >( std::get<1>( _item ) % 2 );
+        }
+    };
+
+    int const items_per_producer = 20000;
+
+    // Every item has to arrive exactly once, and the items of one producer in one lane in the
+    // order they were pushed.
+    template< typename LanePolicy, typename PopFunc >
+    void stress( int const _producers, PopFunc _pop )
+    {
+        sdviz::MPSCQueue< item_type, LanePolicy > queue;
+        std::vector< std::thread > producers;
+        for( int producer = 0; producer < _producers; ++producer )
+        {
+            producers.emplace_back( [&queue, producer](){
+                for( int seq = 0; seq < items_per_producer; ++seq )
+                {
+                    queue.push( item_type{ producer, seq } );
+                }
+            });
+        }
+
+        std::vector< std::vector< int > > next_seqs( _producers, std::vector< int >( LanePolicy::lanes, 0 ) );
+        std::vector< int > counts( _producers, 0 );
+        int const total = _producers * items_per_producer;
+        int received = 0;
+        bool is_ordered = true;
+        while( received < total )
+        {
+            received += _pop( queue, [&]( item_type&& _item ){
+                int const producer = std::get<0>( _item );
+                int const seq = std::get<1>( _item );
+                auto& next_seq = next_seqs[ producer ][ LanePolicy{}( _item ) ];
+                is_ordered = is_ordered && ( next_seq <= seq );
+                next_seq = seq + 1;
+                ++counts[ producer ];
+            });
+        }
+
+        for( auto& producer : producers )
+        {
+            producer.join();
+        }
+
+        SDVIZ_CHECK( is_ordered );
+        SDVIZ_CHECK( received == total );
+        for( int producer = 0; producer < _producers; ++producer )
+        {
+            SDVIZ_CHECK( counts[ producer ] == items_per_producer );
+        }
+        SDVIZ_CHECK( queue.size() == 0 );
+        SDVIZ_CHECK( !queue.waitUntil( std::chrono::steady_clock::now() ) );
+    }
+
+    // Producers drop items while the queue looks full, like the Reject overflow policy of the
+    // context. A size below zero would look full to that check and reject into an empty queue.
+    template< typename PopFunc >
+    void stressReject( int const _producers, PopFunc _pop )
+    {
+        size_t const max_queued_items = 64;
+        sdviz::MPSCQueue< item_type, sdviz::SingleLanePolicy > queue;
+        std::atomic< int > accepted{ 0 };
+        std::atomic< int > running{ _producers };
+        std::atomic< bool > is_size_negative{ false };
+        std::vector< std::thread > producers;
+        for( int producer = 0; producer < _producers; ++producer )
+        {
+            producers.emplace_back( [&, producer](){
+                for( int seq = 0; seq < items_per_producer; ++seq )
+                {
+                    int const size = queue.size();
+                    if( size < 0 )
+                    {
+                        is_size_negative = true;
+                    }
+
+                    if( static_cast< size_t >( size ) < max_queued_items )
+                    {
+                        queue.push( item_type{ producer, seq } );
+                        ++accepted;
+                    }
+                }
+                --running;
+            });
+        }
+
+        int received = 0;
+        while( ( 0 < running ) || ( received < accepted ) )
+        {
+            received += _pop( queue, []( item_type&& ){} );
+            if( queue.size() < 0 )
+            {
+                is_size_negative = true;
+            }
+        }
+
+        for( auto& producer : producers )
+        {
+            producer.join();
+        }
+
+        SDVIZ_CHECK( !is_size_negative );
+        SDVIZ_CHECK( received == accepted );
+        SDVIZ_CHECK( 0 < accepted );
+        SDVIZ_CHECK( queue.size() == 0 );
+    }
+
+    template< typename QueueType, typename ConsumeFunc >
+    int popOne( QueueType& _queue, ConsumeFunc _consume )
+    {
+        _consume( std::move( _queue.front() ) );
+        _queue.pop();
+        return 1;
+    }
+
+    template< typename QueueType, typename ConsumeFunc >
+    int popBatch( QueueType& _queue, ConsumeFunc _consume )
+    {
+        _queue.waitUntil( std::chrono::steady_clock::now() + std::chrono::milliseconds( 10 ) );
+        return static_cast< int >( _queue.popAll( _consume, 256 ) );
+    }
+}
+
+int main()
+{
+    for( int const producers : { 1, 4, 16 } )
+    {
+        stress< sdviz::SingleLanePolicy >( producers, []( auto& _queue, auto _consume ){ return popOne( _queue, _consume ); } );
+        stress< sdviz::SingleLanePolicy >( producers, []( auto& _queue, auto _consume ){ return popBatch( _queue, _consume ); } );
+        stress< ParityLanePolicy >( producers, []( auto& _queue, auto _consume ){ return popOne( _queue, _consume ); } );
+        stress< ParityLanePolicy >( producers, []( auto& _queue, auto _consume ){ return popBatch( _queue, _consume ); } );
+        stressReject( producers, []( auto& _queue, auto _consume ){ return popBatch( _queue, _consume ); } );
+    }
+
+    return SDVIZ_TEST_RESULT();
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "image_impl.hpp"
+#include "pixel_convert.hpp"
+#include "pixel_reference.hpp"
+
+using namespace sdviz;
+
+namespace
+{
+    int const width = 3840;
+    int const height = 2160;
+    int const repeats = 10;
+
+    template< typename ConvertFunc >
+    double measure( ImageImpl const& _image, size_t const _row_size, ConvertFunc _convert )
+    {
+        std::vector< uint8_t > converted( _row_size );
+        auto const begin = std::chrono::steady_clock::now();
+        for( int i = 0; i < repeats; ++i )
+        {
+            for( int y = 0; y < height; ++y )
+            {
+                _convert( _image.getBuffer() + y * _image.getStride(), converted.data() );
+            }
+        }
+        auto const end = std::chrono::steady_clock::now();
+        return repeats * static_cast< double >( width ) * height / std::chrono::duration< double >( end - begin ).count();
+    }
+}
+
+// Prints the megapixels per second PixelConverter and the per pixel reference convert a 4K
+// frame at, for the formats which need converting.
+int main()
+{
+    struct { char const* name; ImageImpl::Format format; } const cases[] = {
+        { "BGR_888", ImageImpl::Format::BGR_888 },
+        { "BGRA_8888", ImageImpl::Format::BGRA_8888 },
+        { "FLOAT_32", ImageImpl::Format::FLOAT_32 }
+    };
+    for( auto const& bench_case : cases )
+    {
+        ImageImpl image( width, height, bench_case.format );
+        for( size_t i = 0; i < height * ImageImpl::GetRowSize( image ); ++i )
+        {
+            image.getBuffer()[ i ] = static_cast< uint8_t >( ( i * 7 ) & 0x3f );
+        }
+
+        auto const range = PixelConverter::GetValueRange( image );
+        PixelConverter const converter( image, range );
+        double const simd = measure( image, converter.getRowSize(), [&]( uint8_t const* _src, uint8_t* _dst ){
+            converter.convertRow( _src, _dst );
+        });
+        double const reference = measure( image, converter.getRowSize(), [&]( uint8_t const* _src, uint8_t* _dst ){
+            test::referenceConvertRow( bench_case.format, _src, _dst, width, range );
+        });
+
+        auto const begin = std::chrono::steady_clock::now();
+        for( int i = 0; i < repeats; ++i )
+        {
+            PixelConverter::GetValueRange( image );
+        }
+        double const range_seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - begin ).count();
+
+        std::cout << bench_case.name << ": PixelConverter " << simd / 1e6 << " MP/s, reference " << reference / 1e6 << " MP/s";
+        if( bench_case.format == ImageImpl::Format::FLOAT_32 )
+        {
+            std::cout << ", value range " << repeats * static_cast< double >( width ) * height / range_seconds / 1e6 << " MP/s";
+        }
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
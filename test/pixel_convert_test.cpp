@@ -0,0 +1,163 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "image_impl.hpp"
+#include "pixel_convert.hpp"
+#include "pixel_reference.hpp"
+#include "test_util.hpp"
+
+using namespace sdviz;
+
+namespace
+{
+    std::mt19937 random_engine( 1234 );
+
+    ImageImpl makeRandomImage( int const _width, int const _height, ImageImpl::Format const _format, size_t const _stride = 0 )
+    {
+        ImageImpl image( _width, _height, _format, nullptr, _stride );
+        std::uniform_int_distribution< int > byte_dist( 0, 255 );
+        std::uniform_real_distribution< float > float_dist( -1000.0f, 1000.0f );
+        for( int y = 0; y < _height; ++y )
+        {
+            uint8_t* const row = image.getBuffer() + y * image.getStride();
+            if( _format == ImageImpl::Format::FLOAT_32 )
+            {
+                for( int x = 0; x < _width; ++x )
+                {
+                    float const value = float_dist( random_engine );
+                    std::memcpy( row + 4 * x, &value, sizeof( value ) );
+                }
+                continue;
+            }
+
+            for( size_t i = 0; i < ImageImpl::GetRowSize( image ); ++i )
+            {
+                row[ i ] = static_cast< uint8_t >( byte_dist( random_engine ) );
+            }
+        }
+
+        return image;
+    }
+
+    void setFloat( ImageImpl& _image, int const _x, int const _y, float const _value )
+    {
+        std::memcpy( _image.getBuffer() + _y * _image.getStride() + 4 * _x, &_value, sizeof( _value ) );
+    }
+
+    bool convertsLikeReference( ImageImpl const& _image, ImageImpl::value_range_type const& _value_range )
+    {
+        PixelConverter const converter( _image, _value_range );
+        std::vector< uint8_t > converted( converter.getRowSize() + 16, 0xcd );
+        std::vector< uint8_t > expected( converter.getRowSize() + 16, 0xcd );
+        for( int y = 0; y < _image.getHeight(); ++y )
+        {
+            uint8_t const* const row = _image.getBuffer() + y * _image.getStride();
+            converter.convertRow( row, converted.data() );
+            test::referenceConvertRow( _image.getFormat(), row, expected.data(), _image.getWidth(), _value_range );
+            if( converted != expected )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool hasSameRange( ImageImpl const& _image )
+    {
+        auto const range = PixelConverter::GetValueRange( _image );
+        auto const expected = test::referenceValueRange( _image );
+        return ( range.first == expected.first ) && ( range.second == expected.second );
+    }
+
+    // Widths around the vector sizes exercise every row tail, the padding of a stride too.
+    void testMatchesReference()
+    {
+        ImageImpl::Format const formats[] = {
+            ImageImpl::Format::RGB_888,
+            ImageImpl::Format::UINT_8,
+            ImageImpl::Format::UINT_16,
+            ImageImpl::Format::BGR_888,
+            ImageImpl::Format::BGRA_8888,
+            ImageImpl::Format::RGBA_8888,
+            ImageImpl::Format::INT_16,
+            ImageImpl::Format::FLOAT_32
+        };
+        for( auto const format : formats )
+        {
+            for( int width = 1; width <= 40; ++width )
+            {
+                auto const packed = makeRandomImage( width, 3, format );
+                SDVIZ_CHECK( convertsLikeReference( packed, PixelConverter::GetValueRange( packed ) ) );
+
+                auto const strided = makeRandomImage( width, 3, format, ImageImpl::GetRowSize( packed ) + 7 );
+                SDVIZ_CHECK( convertsLikeReference( strided, PixelConverter::GetValueRange( strided ) ) );
+                if( format == ImageImpl::Format::FLOAT_32 )
+                {
+                    SDVIZ_CHECK( hasSameRange( packed ) );
+                    SDVIZ_CHECK( hasSameRange( strided ) );
+                }
+            }
+        }
+    }
+
+    // NaNs are left out of the range and become 0, wherever they fall in a vector.
+    void testFloatNaN()
+    {
+        float const nan = std::numeric_limits< float >::quiet_NaN();
+        for( int width = 1; width <= 40; ++width )
+        {
+            auto image = makeRandomImage( width, 2, ImageImpl::Format::FLOAT_32 );
+            for( int x = 0; x < width; x += 3 )
+            {
+                setFloat( image, x, 0, nan );
+            }
+            setFloat( image, width - 1, 1, nan );
+
+            auto const range = PixelConverter::GetValueRange( image );
+            SDVIZ_CHECK( hasSameRange( image ) );
+            SDVIZ_CHECK( convertsLikeReference( image, range ) );
+
+            PixelConverter const converter( image, range );
+            std::vector< uint8_t > converted( converter.getRowSize() );
+            converter.convertRow( image.getBuffer(), converted.data() );
+            SDVIZ_CHECK( ( converted[0] == 0 ) && ( converted[1] == 0 ) );
+        }
+
+        ImageImpl all_nan( 9, 1, ImageImpl::Format::FLOAT_32 );
+        for( int x = 0; x < 9; ++x )
+        {
+            setFloat( all_nan, x, 0, nan );
+        }
+        SDVIZ_CHECK( convertsLikeReference( all_nan, PixelConverter::GetValueRange( all_nan ) ) );
+    }
+
+    // A flat image has an empty range and maps to 0 rather than dividing by it.
+    void testFloatFlat()
+    {
+        ImageImpl flat( 17, 1, ImageImpl::Format::FLOAT_32 );
+        for( int x = 0; x < 17; ++x )
+        {
+            setFloat( flat, x, 0, 42.0f );
+        }
+
+        auto const range = PixelConverter::GetValueRange( flat );
+        SDVIZ_CHECK( convertsLikeReference( flat, range ) );
+
+        PixelConverter const converter( flat, range );
+        std::vector< uint8_t > converted( converter.getRowSize(), 0xff );
+        converter.convertRow( flat.getBuffer(), converted.data() );
+        SDVIZ_CHECK( std::all_of( std::begin( converted ), std::end( converted ), []( uint8_t const _byte ){ return _byte == 0; } ) );
+    }
+}
+
+int main()
+{
+    testMatchesReference();
+    testFloatNaN();
+    testFloatFlat();
+    return SDVIZ_TEST_RESULT();
+}
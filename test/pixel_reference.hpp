@@ -0,0 +1,89 @@
+#ifndef __SDVIZ_PIXEL_REFERENCE_HPP__
+# define __SDVIZ_PIXEL_REFERENCE_HPP__
+
+# include <algorithm>
+# include <cmath>
+# include <cstdint>
+# include <cstring>
+# include <limits>
+
+# include "image_impl.hpp"
+
+namespace sdviz
+{
+    namespace test
+    {
+        // Plain per pixel versions of the conversions PixelConverter vectorizes.
+        inline void referenceConvertRow( ImageImpl::Format const _format,
+                                         uint8_t const* const _src,
+                                         uint8_t* const _dst,
+                                         int const _width,
+                                         ImageImpl::value_range_type const& _value_range )
+        {
+            switch( _format )
+            {
+                case ImageImpl::Format::BGR_888:
+                    for( int i = 0; i < _width; ++i )
+                    {
+                        _dst[ 3 * i + 0 ] = _src[ 3 * i + 2 ];
+                        _dst[ 3 * i + 1 ] = _src[ 3 * i + 1 ];
+                        _dst[ 3 * i + 2 ] = _src[ 3 * i + 0 ];
+                    }
+                    return;
+                case ImageImpl::Format::BGRA_8888:
+                    for( int i = 0; i < _width; ++i )
+                    {
+                        _dst[ 4 * i + 0 ] = _src[ 4 * i + 2 ];
+                        _dst[ 4 * i + 1 ] = _src[ 4 * i + 1 ];
+                        _dst[ 4 * i + 2 ] = _src[ 4 * i + 0 ];
+                        _dst[ 4 * i + 3 ] = _src[ 4 * i + 3 ];
+                    }
+                    return;
+                case ImageImpl::Format::FLOAT_32:
+                {
+                    float const range = _value_range.second - _value_range.first;
+                    float const min = std::isfinite( _value_range.first ) ? _value_range.first : 0.0f;
+                    float const scale = ( std::isfinite( range ) && ( 0.0f < range ) ) ? 65535.0f / range : 0.0f;
+                    for( int i = 0; i < _width; ++i )
+                    {
+                        float value;
+                        std::memcpy( &value, _src + 4 * i, sizeof( value ) );
+                        float const scaled = ( value - min ) * scale;
+                        uint16_t const normalized = std::isnan( scaled ) ? 0 : static_cast< uint16_t >( std::lrint( std::min( std::max( scaled, 0.0f ), 65535.0f ) ) );
+                        std::memcpy( _dst + 2 * i, &normalized, sizeof( normalized ) );
+                    }
+                    return;
+                }
+                default:
+                {
+                    ImageImpl const row( _width, 1, _format );
+                    std::copy( _src, _src + ImageImpl::GetRowSize( row ), _dst );
+                    return;
+                }
+            }
+        }
+
+        inline ImageImpl::value_range_type referenceValueRange( ImageImpl const& _image )
+        {
+            float min = std::numeric_limits< float >::infinity();
+            float max = -std::numeric_limits< float >::infinity();
+            for( int y = 0; y < _image.getHeight(); ++y )
+            {
+                for( int x = 0; x < _image.getWidth(); ++x )
+                {
+                    float value;
+                    std::memcpy( &value, _image.getBuffer() + y * _image.getStride() + 4 * x, sizeof( value ) );
+                    if( !std::isnan( value ) )
+                    {
+                        min = std::min( min, value );
+                        max = std::max( max, value );
+                    }
+                }
+            }
+
+            return ImageImpl::value_range_type{ min, max };
+        }
+    }
+}
+
+#endif // __SDVIZ_PIXEL_REFERENCE_HPP__
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <server_ws.hpp>
+
+namespace
+{
+    using WsServer = SimpleWeb::SocketServer< SimpleWeb::WS >;
+
+    // A 4K RGB frame.
+    size_t const frame_size = 3840 * 2160 * 3;
+    int const repeats = 5;
+
+    // Fills one SendStream per connection from the shared buffer, as ModelSyncServer::send does.
+    template< typename FillFunc >
+    double measure( std::string const& _buffer, int const _connections, FillFunc _fill )
+    {
+        auto const begin = std::chrono::steady_clock::now();
+        size_t total = 0;
+        for( int i = 0; i < repeats; ++i )
+        {
+            for( int connection = 0; connection < _connections; ++connection )
+            {
+                auto send_stream = std::make_shared< WsServer::SendStream >();
+                _fill( _buffer, *send_stream );
+                total += send_stream->size();
+            }
+        }
+        auto const end = std::chrono::steady_clock::now();
+        return total / std::chrono::duration< double >( end - begin ).count();
+    }
+}
+
+// Prints the bytes per second a serialized 4K frame is handed to the sockets at, copied byte by
+// byte through an ostream_iterator as before, and in one bulk write as now.
+int main()
+{
+    std::string buffer( frame_size, '\0' );
+    for( size_t i = 0; i < frame_size; ++i )
+    {
+        buffer[ i ] = static_cast< char >( ( i * 31 ) & 0xff );
+    }
+
+    for( int const connections : { 1, 4, 16 } )
+    {
+        double const per_byte = measure( buffer, connections, []( std::string const& _buffer, WsServer::SendStream& _stream ){
+            std::copy( std::begin( _buffer ), std::end( _buffer ), std::ostream_iterator< char >( _stream ) );
+        });
+        double const bulk = measure( buffer, connections, []( std::string const& _buffer, WsServer::SendStream& _stream ){
+            _stream.write( _buffer.data(), _buffer.size() );
+        });
+        std::cout << connections << " connections: per byte " << per_byte / 1e6 << " MB/s, bulk " << bulk / 1e6 << " MB/s" << std::endl;
+    }
+
+    return 0;
+}
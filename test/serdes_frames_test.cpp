@@ -0,0 +1,85 @@
+#include <memory>
+
+#include "element_impl.hpp"
+#include "serdes.hpp"
+#include "test_util.hpp"
+
+using namespace sdviz;
+
+namespace
+{
+    element_id_type const target_id = 2;
+    int const image_size = 64;
+
+    ImageImpl makeImage( uint8_t const _fill )
+    {
+        ImageImpl image( image_size, image_size, ImageImpl::Format::RGB_888 );
+        std::fill( image.getBuffer(), image.getBuffer() + ImageImpl::GetBufferSize( image ), _fill );
+        return image;
+    }
+
+    CanvasImpl makeCanvas( ImageImpl const& _first, ImageImpl const& _second )
+    {
+        CanvasImpl canvas( image_size * 2, image_size );
+        canvas.addCommand( CanvasImpl::ImageCommand( _first, 0, 0, 1.0 ) );
+        canvas.addCommand( CanvasImpl::RectCommand( 0, 0, 8, 8, 0x00, 0x00, 0x00, 1, false, false ) );
+        canvas.addCommand( CanvasImpl::ImageCommand( _second, image_size, 0, 1.0 ) );
+        return canvas;
+    }
+
+    std::shared_ptr< CanvasElementImpl const > snapshotOf( CanvasElementImpl const& _element )
+    {
+        return std::make_shared< CanvasElementImpl const >( _element.snapshot() );
+    }
+
+    // Only the image the value patch refers to is encoded with the update, the other one is left
+    // for the full form, which still goes out with the frames of both.
+    void testDeltaEncodesChangedImagesOnly()
+    {
+        auto const unchanged = makeImage( 0x10 );
+        CanvasElementImpl element( makeCanvas( unchanged, makeImage( 0x20 ) ), CanvasElementImplParam{} );
+        auto const previous_value = element.getValuePtr();
+        element.setValue( makeCanvas( unchanged, makeImage( 0x30 ) ) );
+
+        auto const value_patch = valueToIntermediatePatch( *previous_value, element.getValue() );
+        auto const update = elementImplToUpdate( target_id, snapshotOf( element ), value_patch );
+        SDVIZ_CHECK( update.frames.size() == 1 );
+        SDVIZ_CHECK( update.frames.count( 2 ) == 1 );
+
+        SerializedUpdate const serialized( update );
+        SDVIZ_CHECK( serialized.getBuffers( true ).size() == 2 );
+        SDVIZ_CHECK( serialized.getBuffers( false ).size() == 3 );
+    }
+
+    void testParamUpdateEncodesNoImage()
+    {
+        CanvasElementImpl element( makeCanvas( makeImage( 0x10 ), makeImage( 0x20 ) ), CanvasElementImplParam{} );
+        element.setParam( CanvasElementImplParam{ 10.0 } );
+
+        auto const update = elementImplToUpdate( target_id, snapshotOf( element ) );
+        SDVIZ_CHECK( update.frames.empty() );
+
+        SerializedUpdate const serialized( update );
+        SDVIZ_CHECK( serialized.getBuffers( true ).size() == 1 );
+        SDVIZ_CHECK( serialized.getBuffers( false ).size() == 3 );
+    }
+
+    // Images are told apart by their buffers, not by their pixels.
+    void testImagesAreComparedByBuffer()
+    {
+        auto const image = makeImage( 0x10 );
+        auto const canvas = makeCanvas( image, image );
+        SDVIZ_CHECK( isSameCanvasCommand( *canvas.cbegin(), *canvas.cbegin() ) );
+        SDVIZ_CHECK( !isSameCanvasCommand( *canvas.cbegin(), *makeCanvas( image.clone(), image ).cbegin() ) );
+        SDVIZ_CHECK( !isSameCanvasCommand( *canvas.cbegin(), *std::next( canvas.cbegin(), 2 ) ) );
+    }
+}
+
+int main()
+{
+    testDeltaEncodesChangedImagesOnly();
+    testParamUpdateEncodesNoImage();
+    testImagesAreComparedByBuffer();
+
+    return SDVIZ_TEST_RESULT();
+}
@@ -0,0 +1,31 @@
+#ifndef __SDVIZ_TEST_UTIL_HPP__
+# define __SDVIZ_TEST_UTIL_HPP__
+
+# include <iostream>
+
+namespace sdviz
+{
+    namespace test
+    {
+        inline int& failureCount()
+        {
+            static int count = 0;
+            return count;
+        }
+    }
+}
+
+// Tests are plain executables which report each failed check and exit non-zero if any failed.
+# define SDVIZ_CHECK( _cond ) \
+    do \
+    { \
+        if( !( _cond ) ) \
+        { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #_cond << std::endl; \
+            ++sdviz::test::failureCount(); \
+        } \
+    } while( false )
+
+# define SDVIZ_TEST_RESULT() ( ( sdviz::test::failureCount() == 0 ) ? 0 : 1 )
+
+#endif // __SDVIZ_TEST_UTIL_HPP__